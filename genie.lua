@@ -1,6 +1,6 @@
 solution "touch-joy"
 	location(_ACTION)
-	configurations {"Develop"}
+	configurations {"Develop", "Benchmark"}
 	platforms {"x64"}
 	targetdir "bin"
 	debugdir "data"
@@ -33,6 +33,10 @@ solution "touch-joy"
 			"NoFramePointer"
 		}
 
+		links {
+			"winmm"
+		}
+
 	project "test"
 		kind "ConsoleApp"
 		language "C"
@@ -49,6 +53,13 @@ solution "touch-joy"
 			"src/*.c"
 		}
 
+		-- Also times the benchmarks after the tests pass
+		configuration "Benchmark"
+			defines {
+				"_BENCHMARK"
+			}
+		configuration {}
+
 		flags {
 			"FatalWarnings",
 			"OptimizeSize",
@@ -58,3 +69,7 @@ solution "touch-joy"
 			"NoNativeWChar",
 			"NoExceptions"
 		}
+
+		links {
+			"winmm"
+		}
@@ -0,0 +1,408 @@
+#include <stddef.h>
+#include "chord.h"
+
+// Index of the chord made of exactly these buttons or -1
+static int FindChord(const ChordTable* table, uint32_t buttons)
+{
+	for (int i = 0; i < table->numChords; ++i)
+	{
+		if (table->chords[i].buttons == buttons) { return i; }
+	}
+
+	return -1;
+}
+
+// Latest time a chord containing these buttons can still complete, 0 if
+// none can
+static Timestamp GetChordDeadline(const ChordTable* table, uint32_t buttons)
+{
+	Timestamp deadline = 0;
+	for (int i = 0; i < table->numChords; ++i)
+	{
+		const Chord* chord = &table->chords[i];
+		if ((chord->buttons & buttons) != buttons) { continue; }
+
+		Timestamp end = table->firstPress + chord->window;
+		if (end > deadline) { deadline = end; }
+	}
+
+	return deadline;
+}
+
+// Whether a chord other than an exact match can still complete
+static bool HasLongerChord(const ChordTable* table, uint32_t buttons)
+{
+	for (int i = 0; i < table->numChords; ++i)
+	{
+		uint32_t chordButtons = table->chords[i].buttons;
+		if (chordButtons != buttons && (chordButtons & buttons) == buttons)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void ClearPending(ChordTable* table)
+{
+	table->pending = 0;
+	table->numPending = 0;
+	CancelTimer(table->scheduler, &table->timer);
+}
+
+static void PassPending(ChordTable* table)
+{
+	// Copy first as the pass procedure may press again
+	int numPending = table->numPending;
+	uint8_t order[MAX_CHORD_BUTTONS];
+	for (int i = 0; i < numPending; ++i) { order[i] = table->pendingOrder[i]; }
+
+	ClearPending(table);
+
+	for (int i = 0; i < numPending; ++i)
+	{
+		table->pass(table->passData, order[i], true);
+	}
+}
+
+static void FireChord(ChordTable* table, int index)
+{
+	table->consumed |= table->pending;
+	table->activeChords |= 1u << index;
+	ClearPending(table);
+
+	OutputKey(table->output, table->chords[index].code, true);
+}
+
+static void OnChordTimer(Timer* timer, Timestamp now)
+{
+	(void)now;
+	ChordTable* table = (ChordTable*)timer->userData;
+
+	int chord = FindChord(table, table->pending);
+	if (chord >= 0)
+	{
+		FireChord(table, chord);
+	}
+	else
+	{
+		PassPending(table);
+	}
+}
+
+void InitChordTable(ChordTable* table)
+{
+	table->numChords = 0;
+	table->chordButtons = 0;
+	table->scheduler = NULL;
+}
+
+bool AddChord(ChordTable* table, uint32_t buttons, uint16_t code, Timestamp window)
+{
+	if (table->numChords == MAX_CHORDS) { return false; }
+
+	Chord* chord = &table->chords[table->numChords++];
+	chord->buttons = buttons;
+	chord->code = code;
+	chord->window = window;
+	table->chordButtons |= buttons;
+
+	return true;
+}
+
+void StartChords(
+	ChordTable* table,
+	Scheduler* scheduler,
+	Output* output,
+	ChordPassProc pass,
+	void* passData
+)
+{
+	InitTimer(&table->timer, &OnChordTimer, table);
+	table->scheduler = scheduler;
+	table->output = output;
+	table->pass = pass;
+	table->passData = passData;
+	table->pending = 0;
+	table->numPending = 0;
+	table->consumed = 0;
+	table->activeChords = 0;
+}
+
+void StopChords(ChordTable* table)
+{
+	if (!table->scheduler) { return; }
+
+	ClearPending(table);
+	table->consumed = 0;
+	table->activeChords = 0;
+}
+
+bool ChordPress(ChordTable* table, int button, Timestamp now)
+{
+	uint32_t bit = 1u << button;
+	// The common case: nothing to wait for
+	if (!(table->chordButtons & bit)) { return false; }
+
+	uint32_t pressed = table->pending | bit;
+	if (GetChordDeadline(table, pressed) == 0)
+	{
+		// What was buffered so far can no longer become a chord but this
+		// press may still start one
+		PassPending(table);
+		pressed = bit;
+	}
+
+	if (table->numPending == 0) { table->firstPress = now; }
+	table->pending = pressed;
+	table->pendingOrder[table->numPending++] = (uint8_t)button;
+
+	int chord = FindChord(table, pressed);
+	if (chord >= 0 && !HasLongerChord(table, pressed))
+	{
+		FireChord(table, chord);
+	}
+	else
+	{
+		ScheduleTimer(
+			table->scheduler, &table->timer, GetChordDeadline(table, pressed)
+		);
+	}
+
+	return true;
+}
+
+bool ChordRelease(ChordTable* table, int button)
+{
+	uint32_t bit = 1u << button;
+
+	if (table->pending & bit)
+	{
+		// Released before the window ended: a complete chord is a tap,
+		// anything else was a normal press
+		int chord = FindChord(table, table->pending);
+		if (chord < 0)
+		{
+			PassPending(table);
+			return false;
+		}
+
+		FireChord(table, chord);
+	}
+
+	if (!(table->consumed & bit)) { return false; }
+
+	// The chord key is released as soon as any of its buttons is
+	table->consumed &= ~bit;
+	for (int i = 0; i < table->numChords; ++i)
+	{
+		uint32_t chordBit = 1u << i;
+		if ((table->activeChords & chordBit) && (table->chords[i].buttons & bit))
+		{
+			table->activeChords &= ~chordBit;
+			OutputKey(table->output, table->chords[i].code, false);
+		}
+	}
+
+	return true;
+}
+
+#ifdef _TEST
+
+#include <time.h>
+#include "utest.h"
+#include "utils.h"
+
+typedef struct
+{
+	int numEvents;
+	int buttons[16];
+	bool downs[16];
+} PassLog;
+
+static void LogPass(void* userData, int button, bool down)
+{
+	PassLog* log = (PassLog*)userData;
+	if (log->numEvents == 16) { return; }
+
+	log->buttons[log->numEvents] = button;
+	log->downs[log->numEvents] = down;
+	++log->numEvents;
+}
+
+static void RunUntil(Scheduler* scheduler, Timestamp* clock, Timestamp end)
+{
+	Timestamp due;
+	while (GetNextDeadline(scheduler, &due) && due <= end)
+	{
+		*clock = due;
+		RunScheduler(scheduler, due);
+	}
+	*clock = end;
+}
+
+TEST(chord_resolve)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	ChordTable table;
+	PassLog log = { 0 };
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitChordTable(&table);
+	// 0+1, 0+1+3 and 4+5 are chords, 2 is a plain button
+	TEST_ASSERT(AddChord(&table, 0x3, 'X', 50000));
+	TEST_ASSERT(AddChord(&table, 0xB, 'Y', 50000));
+	TEST_ASSERT(AddChord(&table, 0x30, 'Z', 50000));
+	StartChords(&table, &scheduler, &output, &LogPass, &log);
+
+	// Plain buttons are handled right away
+	TEST_ASSERT(!ChordPress(&table, 2, clock));
+	TEST_ASSERT(!ChordRelease(&table, 2));
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+
+	// 0+1 could still grow into 0+1+3 so it resolves when the window ends
+	TEST_ASSERT(ChordPress(&table, 0, clock));
+	RunUntil(&scheduler, &clock, 10000);
+	TEST_ASSERT(ChordPress(&table, 1, clock));
+	RunUntil(&scheduler, &clock, 49999);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(0, recorder.numEvents);
+	RunUntil(&scheduler, &clock, 50000);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(1, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT('X', recorder.events[0].event.data.key.code);
+
+	// Either release ends the chord, the other one is swallowed
+	TEST_ASSERT(ChordRelease(&table, 1));
+	TEST_ASSERT(ChordRelease(&table, 0));
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(2, recorder.numEvents);
+	TEST_ASSERT(!recorder.events[1].event.data.key.down);
+
+	// The longest chord resolves as soon as it is complete
+	clock = 200000;
+	ChordPress(&table, 3, clock);
+	ChordPress(&table, 1, clock);
+	ChordPress(&table, 0, clock);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+	ChordRelease(&table, 0);
+	ChordRelease(&table, 1);
+	ChordRelease(&table, 3);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(4, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT('Y', recorder.events[2].event.data.key.code);
+
+	// A lone press is passed on once the window ends
+	clock = 300000;
+	ChordPress(&table, 0, clock);
+	RunUntil(&scheduler, &clock, 400000);
+	TEST_ASSERT_EQUAL_INT(1, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(0, log.buttons[0]);
+	TEST_ASSERT(!ChordRelease(&table, 0));
+
+	// A quick tap is passed on at release
+	ChordPress(&table, 1, clock);
+	TEST_ASSERT(!ChordRelease(&table, 1));
+	TEST_ASSERT_EQUAL_INT(2, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(1, log.buttons[1]);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+
+	// A press which cannot join the buffered ones flushes them
+	ChordPress(&table, 3, clock);
+	ChordPress(&table, 4, clock);
+	TEST_ASSERT_EQUAL_INT(3, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(3, log.buttons[2]);
+	TEST_ASSERT(!ChordRelease(&table, 4));
+	TEST_ASSERT_EQUAL_INT(4, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(4, log.buttons[3]);
+
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(4, recorder.numEvents);
+}
+
+// Press and release buttons which are not part of any chord while every
+// chord is defined. Return how many of them were held back.
+static int PressOtherButtons(ChordTable* table, int iterations)
+{
+	int handled = 0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		int button = 16 + (i & 15);
+		handled += ChordPress(table, button, (Timestamp)i);
+		handled += ChordRelease(table, button);
+	}
+
+	return handled;
+}
+
+static void StartFullTable(
+	ChordTable* table, Scheduler* scheduler, Output* output, PassLog* log
+)
+{
+	InitChordTable(table);
+	for (int i = 0; i < MAX_CHORDS; ++i)
+	{
+		AddChord(table, 3u << (i * 2 % 16), (uint16_t)('A' + i), 50000);
+	}
+	StartChords(table, scheduler, output, &LogPass, log);
+}
+
+TEST(chord_passthrough)
+{
+	static OutputRecorder recorder;
+	Scheduler scheduler;
+	Timestamp now = 0;
+	Output output;
+	ChordTable table;
+	PassLog log = { 0 };
+
+	InitOutputRecorder(&recorder, &now);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	StartFullTable(&table, &scheduler, &output, &log);
+
+	// Non-chord presses are never delayed
+	TEST_ASSERT_EQUAL_INT(0, PressOtherButtons(&table, 1000));
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+}
+
+#ifdef _BENCHMARK
+
+// Cost of the chord check on buttons which are not part of any chord
+TEST(chord_benchmark)
+{
+	static OutputRecorder recorder;
+	Scheduler scheduler;
+	Timestamp now = 0;
+	Output output;
+	ChordTable table;
+	PassLog log = { 0 };
+
+	InitOutputRecorder(&recorder, &now);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	StartFullTable(&table, &scheduler, &output, &log);
+
+	const int iterations = 10000000;
+	clock_t start = clock();
+	int handled = PressOtherButtons(&table, iterations);
+	clock_t end = clock();
+	TEST_ASSERT_EQUAL_INT(0, handled);
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	ReportBenchmark(
+		"chord_benchmark",
+		"%.2f ns per non-chord event",
+		seconds * 1e9 / (iterations * 2.0)
+	);
+}
+
+#endif
+
+#endif
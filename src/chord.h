@@ -0,0 +1,69 @@
+#ifndef TOUCH_JOY_CHORD_H
+#define TOUCH_JOY_CHORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+#define MAX_CHORDS 16
+#define MAX_CHORD_BUTTONS 32
+
+typedef struct
+{
+	// Bit i is set when button i is part of the chord
+	uint32_t buttons;
+	uint16_t code;
+	Timestamp window;
+} Chord;
+
+// Receives presses and releases which did not turn out to be part of a chord
+typedef void(*ChordPassProc)(void* userData, int button, bool down);
+
+// Resolves simultaneous presses of several buttons into chords.
+//
+// Buttons which are not part of any chord are never buffered. Presses of the
+// others are held back until they either complete a chord or can no longer
+// become one, at which point they are passed on in order.
+typedef struct
+{
+	int numChords;
+	Chord chords[MAX_CHORDS];
+	// Union of all chords
+	uint32_t chordButtons;
+
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	ChordPassProc pass;
+	void* passData;
+	// Presses held back, in order
+	uint32_t pending;
+	int numPending;
+	uint8_t pendingOrder[MAX_CHORD_BUTTONS];
+	Timestamp firstPress;
+	// Buttons held as part of a chord, their releases are swallowed
+	uint32_t consumed;
+	// Bit i is set while chord i is held
+	uint32_t activeChords;
+} ChordTable;
+
+void InitChordTable(ChordTable* table);
+bool AddChord(ChordTable* table, uint32_t buttons, uint16_t code, Timestamp window);
+// Reset playback state, must be called before any press
+void StartChords(
+	ChordTable* table,
+	Scheduler* scheduler,
+	Output* output,
+	ChordPassProc pass,
+	void* passData
+);
+// Drop buffered presses and stop the timer. Keys of held chords are left to
+// the caller to release.
+void StopChords(ChordTable* table);
+// Return true if the event was taken by the chord table, false if the caller
+// should handle it right away
+bool ChordPress(ChordTable* table, int button, Timestamp now);
+bool ChordRelease(ChordTable* table, int button);
+
+#endif
@@ -0,0 +1,296 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "curve.h"
+
+#define CURVE_SCALE 65535.f
+
+typedef float(*CurveProc)(const void* params, float x);
+
+typedef struct
+{
+	float x1, y1, x2, y2;
+} Bezier;
+
+typedef struct
+{
+	int numPoints;
+	float xs[MAX_CURVE_POINTS + 2];
+	float ys[MAX_CURVE_POINTS + 2];
+} Polyline;
+
+static void Bake(Curve* curve, CurveProc proc, const void* params)
+{
+	for (int i = 0; i <= CURVE_SEGMENTS; ++i)
+	{
+		float y = proc(params, (float)i / (float)CURVE_SEGMENTS);
+		if (y < 0.f) { y = 0.f; }
+		if (y > 1.f) { y = 1.f; }
+
+		curve->table[i] = (uint16_t)(y * CURVE_SCALE + 0.5f);
+	}
+}
+
+static float Linear(const void* params, float x)
+{
+	(void)params;
+	return x;
+}
+
+static float Power(const void* params, float x)
+{
+	return powf(x, *(const float*)params);
+}
+
+static float BezierCoordinate(float t, float p1, float p2)
+{
+	float u = 1.f - t;
+	return 3.f * u * u * t * p1 + 3.f * u * t * t * p2 + t * t * t;
+}
+
+static float CubicBezier(const void* params, float x)
+{
+	const Bezier* bezier = (const Bezier*)params;
+
+	// x(t) is monotonic since the control points are within [0, 1], so
+	// bisection always finds t
+	float low = 0.f;
+	float high = 1.f;
+	for (int i = 0; i < 32; ++i)
+	{
+		float t = (low + high) * 0.5f;
+		if (BezierCoordinate(t, bezier->x1, bezier->x2) < x)
+		{
+			low = t;
+		}
+		else
+		{
+			high = t;
+		}
+	}
+
+	return BezierCoordinate((low + high) * 0.5f, bezier->y1, bezier->y2);
+}
+
+static float Lines(const void* params, float x)
+{
+	const Polyline* polyline = (const Polyline*)params;
+
+	int i = 1;
+	while (i < polyline->numPoints - 1 && x > polyline->xs[i]) { ++i; }
+
+	float x0 = polyline->xs[i - 1];
+	float y0 = polyline->ys[i - 1];
+	return y0 + (x - x0) / (polyline->xs[i] - x0) * (polyline->ys[i] - y0);
+}
+
+static bool TakeWord(const char** cursor, const char* word)
+{
+	size_t length = strlen(word);
+	if (strncmp(*cursor, word, length) != 0) { return false; }
+
+	char next = (*cursor)[length];
+	if (next != 0 && next != ' ') { return false; }
+
+	*cursor += length;
+	return true;
+}
+
+// Read numbers separated by spaces, or by a colon within a point
+static int ParseNumbers(const char* cursor, float* numbers, int maxNumbers)
+{
+	int count = 0;
+	for (;;)
+	{
+		while (*cursor == ' ' || *cursor == ':') { ++cursor; }
+		if (*cursor == 0) { return count; }
+		if (count == maxNumbers) { return -1; }
+
+		char* end;
+		numbers[count++] = strtof(cursor, &end);
+		if (end == cursor) { return -1; }
+		if (*end != 0 && *end != ' ' && *end != ':') { return -1; }
+
+		cursor = end;
+	}
+}
+
+void InitLinearCurve(Curve* curve)
+{
+	Bake(curve, &Linear, NULL);
+}
+
+bool CompileCurve(const char* source, Curve* curve, const char** error)
+{
+	const char* cursor = source;
+	while (*cursor == ' ') { ++cursor; }
+
+	float numbers[MAX_CURVE_POINTS * 2];
+	if (TakeWord(&cursor, "linear"))
+	{
+		if (ParseNumbers(cursor, numbers, 0) != 0)
+		{
+			*error = "Invalid curve";
+			return false;
+		}
+
+		InitLinearCurve(curve);
+	}
+	else if (TakeWord(&cursor, "power"))
+	{
+		int count = ParseNumbers(cursor, numbers, 1);
+		if (count != 1 || numbers[0] <= 0.f || numbers[0] > 10.f)
+		{
+			*error = "Invalid curve exponent";
+			return false;
+		}
+
+		Bake(curve, &Power, &numbers[0]);
+	}
+	else if (TakeWord(&cursor, "bezier"))
+	{
+		Bezier bezier;
+		if (ParseNumbers(cursor, numbers, 4) != 4)
+		{
+			*error = "A bezier curve needs two control points";
+			return false;
+		}
+
+		bezier.x1 = numbers[0];
+		bezier.y1 = numbers[1];
+		bezier.x2 = numbers[2];
+		bezier.y2 = numbers[3];
+		if (
+			bezier.x1 < 0.f || bezier.x1 > 1.f
+				|| bezier.x2 < 0.f || bezier.x2 > 1.f
+		)
+		{
+			*error = "Bezier control points must be within [0, 1] horizontally";
+			return false;
+		}
+
+		Bake(curve, &CubicBezier, &bezier);
+	}
+	else if (TakeWord(&cursor, "points"))
+	{
+		int count = ParseNumbers(cursor, numbers, MAX_CURVE_POINTS * 2);
+		if (count <= 0 || count % 2 != 0)
+		{
+			*error = "Invalid curve points";
+			return false;
+		}
+
+		Polyline polyline;
+		polyline.numPoints = 0;
+		polyline.xs[polyline.numPoints] = 0.f;
+		polyline.ys[polyline.numPoints++] = 0.f;
+		for (int i = 0; i < count; i += 2)
+		{
+			float x = numbers[i];
+			float y = numbers[i + 1];
+			float lastX = polyline.xs[polyline.numPoints - 1];
+			if (x <= lastX || x >= 1.f || y < 0.f || y > 1.f)
+			{
+				*error = "Curve points must be increasing and within [0, 1]";
+				return false;
+			}
+
+			polyline.xs[polyline.numPoints] = x;
+			polyline.ys[polyline.numPoints++] = y;
+		}
+		polyline.xs[polyline.numPoints] = 1.f;
+		polyline.ys[polyline.numPoints++] = 1.f;
+
+		Bake(curve, &Lines, &polyline);
+	}
+	else
+	{
+		*error = "Unknown curve";
+		return false;
+	}
+
+	return true;
+}
+
+float ApplyCurve(const Curve* curve, float value)
+{
+	float magnitude = value < 0.f ? -value : value;
+	if (magnitude >= 1.f) { magnitude = 1.f; }
+
+	float position = magnitude * (float)CURVE_SEGMENTS;
+	int index = (int)position;
+	if (index == CURVE_SEGMENTS) { index = CURVE_SEGMENTS - 1; }
+
+	float fraction = position - (float)index;
+	float low = (float)curve->table[index];
+	float high = (float)curve->table[index + 1];
+	float result = (low + (high - low) * fraction) / CURVE_SCALE;
+
+	return value < 0.f ? -result : result;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+// Largest difference between the baked curve and the analytic one
+static float MaxCurveError(const Curve* curve, CurveProc proc, const void* params)
+{
+	float maxError = 0.f;
+	for (int i = 0; i <= 10000; ++i)
+	{
+		float x = (float)i / 10000.f;
+		float error = fabsf(ApplyCurve(curve, x) - proc(params, x));
+		if (error > maxError) { maxError = error; }
+	}
+
+	return maxError;
+}
+
+TEST(curve_lookup)
+{
+	Curve curve;
+	const char* error;
+
+	TEST_ASSERT(CompileCurve("linear", &curve, &error));
+	TEST_ASSERT(MaxCurveError(&curve, &Linear, NULL) < 1e-4f);
+	TEST_ASSERT(fabsf(ApplyCurve(&curve, -0.25f) + 0.25f) < 1e-4f);
+
+	const char* sources[] = { "power 1.5", "power 2", "power 3" };
+	float exponents[] = { 1.5f, 2.f, 3.f };
+	for (int i = 0; i < 3; ++i)
+	{
+		TEST_ASSERT(CompileCurve(sources[i], &curve, &error));
+		TEST_ASSERT(MaxCurveError(&curve, &Power, &exponents[i]) < 1e-4f);
+	}
+
+	// The slope is infinite at 0 so the first segment is less accurate
+	float root = 0.5f;
+	TEST_ASSERT(CompileCurve("power 0.5", &curve, &error));
+	TEST_ASSERT(MaxCurveError(&curve, &Power, &root) < 2e-2f);
+
+	// Compare with points on the parametric curve itself
+	Bezier bezier = { 0.4f, 0.f, 0.8f, 0.5f };
+	TEST_ASSERT(CompileCurve("bezier 0.4 0 0.8 0.5", &curve, &error));
+	for (int i = 0; i <= 1000; ++i)
+	{
+		float t = (float)i / 1000.f;
+		float x = BezierCoordinate(t, bezier.x1, bezier.x2);
+		float y = BezierCoordinate(t, bezier.y1, bezier.y2);
+		TEST_ASSERT(fabsf(ApplyCurve(&curve, x) - y) < 1e-3f);
+	}
+
+	TEST_ASSERT(CompileCurve("points 0.5:0.2 0.8:0.6", &curve, &error));
+	TEST_ASSERT(fabsf(ApplyCurve(&curve, 0.5f) - 0.2f) < 1e-4f);
+	TEST_ASSERT(fabsf(ApplyCurve(&curve, 0.65f) - 0.4f) < 1e-4f);
+	TEST_ASSERT(fabsf(ApplyCurve(&curve, -1.f) + 1.f) < 1e-4f);
+
+	TEST_ASSERT(!CompileCurve("power", &curve, &error));
+	TEST_ASSERT(!CompileCurve("power -1", &curve, &error));
+	TEST_ASSERT(!CompileCurve("bezier 0 0 2 1", &curve, &error));
+	TEST_ASSERT(!CompileCurve("points 0.5:0.2 0.4:0.6", &curve, &error));
+	TEST_ASSERT(!CompileCurve("points 0.5", &curve, &error));
+	TEST_ASSERT(!CompileCurve("spline", &curve, &error));
+}
+
+#endif
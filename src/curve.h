@@ -0,0 +1,29 @@
+#ifndef TOUCH_JOY_CURVE_H
+#define TOUCH_JOY_CURVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CURVE_SEGMENTS 256
+#define MAX_CURVE_POINTS 16
+
+// A response curve from [0, 1] to [0, 1], baked into a table which is
+// interpolated so that applying it costs no more than a linear curve
+typedef struct
+{
+	uint16_t table[CURVE_SEGMENTS + 1];
+} Curve;
+
+void InitLinearCurve(Curve* curve);
+// Bake a curve from one of:
+// * "linear"
+// * "power 2.5": deflection raised to an exponent
+// * "bezier 0.4 0 0.8 0.5": cubic bezier from (0, 0) to (1, 1) with the
+//   given control points, like CSS easing functions
+// * "points 0.5:0.2 0.8:0.6": straight lines through the points and the
+//   ends (0, 0) and (1, 1)
+bool CompileCurve(const char* source, Curve* curve, const char** error);
+// Apply to a deflection in [-1, 1], keeping its sign
+float ApplyCurve(const Curve* curve, float value);
+
+#endif
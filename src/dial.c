@@ -0,0 +1,207 @@
+#include <string.h>
+#include "dial.h"
+
+// One notch
+#define WHEEL_NOTCH 120
+
+// Angle of (x, y) in degrees in [0, 360), growing clockwise on screen.
+//
+// This runs for every move event so it avoids atan2: the point is folded
+// into the first octant, where atan(t) for t in [0, 1] is approximated by
+// a quadratic to within a quarter of a degree.
+static float ApproximateAngle(int x, int y)
+{
+	float ax = (float)(x < 0 ? -x : x);
+	float ay = (float)(y < 0 ? -y : y);
+	if (ax == 0.f && ay == 0.f) { return 0.f; }
+
+	float t = ax < ay ? ax / ay : ay / ax;
+	float angle = 45.f * t + 15.64f * t * (1.f - t);
+
+	if (ax < ay) { angle = 90.f - angle; }
+	if (x < 0) { angle = 180.f - angle; }
+	if (y < 0) { angle = 360.f - angle; }
+
+	return angle >= 360.f ? angle - 360.f : angle;
+}
+
+void InitDial(Dial* dial)
+{
+	memset(dial, 0, sizeof(Dial));
+	dial->step = DEFAULT_DIAL_STEP;
+	dial->sensitivity = 1.f;
+	InitKeyStepper(&dial->steps);
+}
+
+void LayoutDial(Dial* dial, int centerX, int centerY, int deadZone)
+{
+	dial->centerX = centerX;
+	dial->centerY = centerY;
+	dial->deadZone = deadZone;
+}
+
+void DialDown(Dial* dial, int x, int y)
+{
+	dial->active = true;
+	dial->tracking = false;
+	DialMove(dial, NULL, NULL, x, y, 0);
+}
+
+static void OutputRotation(
+	Dial* dial, Scheduler* scheduler, Output* output, float degrees, Timestamp now
+)
+{
+	float scale = dial->mode == DIAL_MOUSE ? dial->sensitivity : 1.f / dial->step;
+	float move = degrees * scale + dial->remainder;
+	int whole = (int)move;
+	// Carry what is left so slow turns add up instead of being lost
+	dial->remainder = move - (float)whole;
+
+	if (whole == 0) { return; }
+
+	switch (dial->mode)
+	{
+	case DIAL_WHEEL:
+		OutputWheel(output, whole * WHEEL_NOTCH);
+		break;
+	case DIAL_STEPS:
+		QueueKeySteps(&dial->steps, scheduler, output, dial->codes, whole, now);
+		break;
+	case DIAL_MOUSE:
+		OutputMouseMove(output, whole, 0);
+		break;
+	}
+}
+
+void DialMove(
+	Dial* dial, Scheduler* scheduler, Output* output, int x, int y, Timestamp now
+)
+{
+	if (!dial->active) { return; }
+
+	int dx = x - dial->centerX;
+	int dy = y - dial->centerY;
+	int64_t distanceSquared = (int64_t)dx * dx + (int64_t)dy * dy;
+	if (distanceSquared < (int64_t)dial->deadZone * dial->deadZone)
+	{
+		// Start over from wherever the finger leaves the dead zone
+		dial->tracking = false;
+		return;
+	}
+
+	float angle = ApproximateAngle(dx, dy);
+	if (dial->tracking)
+	{
+		// Take the short way around so crossing 0 degrees is not a full turn
+		float delta = angle - dial->lastAngle;
+		if (delta > 180.f) { delta -= 360.f; }
+		if (delta < -180.f) { delta += 360.f; }
+
+		OutputRotation(dial, scheduler, output, delta, now);
+	}
+
+	dial->tracking = true;
+	dial->lastAngle = angle;
+}
+
+void DialUp(Dial* dial)
+{
+	dial->active = false;
+	dial->tracking = false;
+}
+
+void StopDial(Dial* dial)
+{
+	StopKeySteps(&dial->steps);
+}
+
+#ifdef _TEST
+
+#include <math.h>
+#include "utest.h"
+
+TEST(dial_rotation)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Dial dial;
+	const float pi = 3.14159265f;
+
+	// The approximation stays close to atan2 all the way around
+	for (int i = 0; i < 3600; ++i)
+	{
+		float radians = (float)i / 3600.f * 2.f * pi;
+		int x = (int)(10000.f * cosf(radians));
+		int y = (int)(10000.f * sinf(radians));
+		float expected = atan2f((float)y, (float)x) * 180.f / pi;
+		if (expected < 0.f) { expected += 360.f; }
+
+		float error = fabsf(ApproximateAngle(x, y) - expected);
+		if (error > 180.f) { error = 360.f - error; }
+		TEST_ASSERT(error < 0.3f);
+	}
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitDial(&dial);
+	dial.mode = DIAL_STEPS;
+	dial.step = 7.f;
+	dial.codes[DIAL_COUNTERCLOCKWISE] = 'A';
+	dial.codes[DIAL_CLOCKWISE] = 'D';
+	LayoutDial(&dial, 50000, 50000, 1000);
+
+	// Three clockwise turns in tiny increments, as from a fast digitizer,
+	// starting just before the wrap around
+	int samples = 3 * 1000;
+	for (int i = 0; i <= samples; ++i)
+	{
+		float radians = (-0.1f + (float)i / 1000.f * 2.f * pi);
+		int x = 50000 + (int)(8000.f * cosf(radians));
+		int y = 50000 + (int)(8000.f * sinf(radians));
+
+		if (i == 0)
+		{
+			DialDown(&dial, x, y);
+		}
+		else
+		{
+			DialMove(&dial, &scheduler, &output, x, y, clock);
+		}
+	}
+	DialUp(&dial);
+
+	// Steps are tapped one at a time, each held for a pulse
+	Timestamp due;
+	while (GetNextDeadline(&scheduler, &due))
+	{
+		FlushOutput(&output);
+		clock = due;
+		RunScheduler(&scheduler, due);
+	}
+	FlushOutput(&output);
+
+	// 1080 / 7 = 154.3, nothing is lost to the small increments
+	TEST_ASSERT_EQUAL_INT(154 * 2, recorder.numEvents);
+	for (int i = 0; i < recorder.numEvents; ++i)
+	{
+		const RecordedOutput* event = &recorder.events[i];
+		TEST_ASSERT_EQUAL_INT('D', event->event.data.key.code);
+		TEST_ASSERT(event->time == (Timestamp)i * KEY_PULSE_LENGTH);
+	}
+
+	// Turning back through the dead zone does not count the jump
+	recorder.numEvents = 0;
+	DialDown(&dial, 58000, 50000);
+	DialMove(&dial, &scheduler, &output, 50000, 50000, clock);
+	DialMove(&dial, &scheduler, &output, 42000, 50000, clock);
+	DialMove(&dial, &scheduler, &output, 42000, 49700, clock);
+	DialUp(&dial);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(0, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+}
+
+#endif
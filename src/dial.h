@@ -0,0 +1,61 @@
+#ifndef TOUCH_JOY_DIAL_H
+#define TOUCH_JOY_DIAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+#include "stepper.h"
+
+#define DEFAULT_DIAL_STEP 15
+
+typedef enum
+{
+	// Scroll one notch per step, clockwise scrolls up
+	DIAL_WHEEL,
+	// Tap a key per step, one after the other
+	DIAL_STEPS,
+	// Move the mouse horizontally, clockwise moves right
+	DIAL_MOUSE
+} DialMode;
+
+enum
+{
+	DIAL_COUNTERCLOCKWISE = STEP_DECREASE,
+	DIAL_CLOCKWISE = STEP_INCREASE
+};
+
+// Turns circular motion around a center into rotation steps.
+typedef struct
+{
+	DialMode mode;
+	// Degrees per step
+	float step;
+	uint16_t codes[2];
+	// Pixels per degree in mouse mode
+	float sensitivity;
+	int centerX;
+	int centerY;
+	// Angles are unstable close to the center so touches there are ignored
+	int deadZone;
+
+	bool active;
+	// Whether lastAngle is valid
+	bool tracking;
+	float lastAngle;
+	// Rotation which has not been output yet, in steps or pixels
+	float remainder;
+	KeyStepper steps;
+} Dial;
+
+void InitDial(Dial* dial);
+void LayoutDial(Dial* dial, int centerX, int centerY, int deadZone);
+void DialDown(Dial* dial, int x, int y);
+void DialMove(
+	Dial* dial, Scheduler* scheduler, Output* output, int x, int y, Timestamp now
+);
+// Steps still being tapped carry on after the finger lifts
+void DialUp(Dial* dial);
+void StopDial(Dial* dial);
+
+#endif
@@ -0,0 +1,549 @@
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+// For fileno
+#define _DEFAULT_SOURCE
+#endif
+
+#include "evdev.h"
+#include "utils.h"
+
+#ifdef __linux__
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#endif
+
+void InitEvdevParser(EvdevParser* parser, TouchProc proc, void* userData)
+{
+	for (int i = 0; i < MAX_EVDEV_SLOTS; ++i)
+	{
+		EvdevSlot* slot = &parser->slots[i];
+		slot->trackingId = -1;
+		slot->x = 0;
+		slot->y = 0;
+		slot->reportedId = -1;
+		slot->reportedX = 0;
+		slot->reportedY = 0;
+		slot->changed = false;
+	}
+
+	parser->slot = 0;
+	parser->dropped = false;
+	parser->proc = proc;
+	parser->userData = userData;
+	SetEvdevRange(parser, 0, 0, 0, 0, 0, 0);
+}
+
+void SetEvdevRange(
+	EvdevParser* parser,
+	int minX,
+	int maxX,
+	int minY,
+	int maxY,
+	int width,
+	int height
+)
+{
+	parser->minX = minX;
+	parser->maxX = maxX;
+	parser->minY = minY;
+	parser->maxY = maxY;
+	parser->width = width;
+	parser->height = height;
+}
+
+bool QueryEvdevRange(EvdevParser* parser, FILE* device, int width, int height)
+{
+#ifdef __linux__
+	struct input_absinfo x;
+	struct input_absinfo y;
+	int fd = fileno(device);
+	if (
+		ioctl(fd, EVIOCGABS(ABS_MT_POSITION_X), &x) < 0
+			|| ioctl(fd, EVIOCGABS(ABS_MT_POSITION_Y), &y) < 0
+	)
+	{
+		return false;
+	}
+
+	SetEvdevRange(parser, x.minimum, x.maximum, y.minimum, y.maximum, width, height);
+	return true;
+#else
+	UNUSED(parser);
+	UNUSED(device);
+	UNUSED(width);
+	UNUSED(height);
+	return false;
+#endif
+}
+
+// Device units to hundredths of a screen pixel. The ends of the range are
+// the first and last pixels, so that touches at the edge of the panel hit
+// buttons flush with the edge of the screen.
+static int ScaleAxis(int value, int min, int max, int size)
+{
+	if (max <= min) { return value * 100; }
+
+	return (int)((int64_t)(value - min) * (size - 1) * 100 / (max - min));
+}
+
+static void EmitPoint(
+	EvdevParser* parser, TouchEvent event, int id, int x, int y, Timestamp time
+)
+{
+	TouchPoint point;
+	point.id = (uint32_t)id;
+	point.event = event;
+	point.x = ScaleAxis(x, parser->minX, parser->maxX, parser->width);
+	point.y = ScaleAxis(y, parser->minY, parser->maxY, parser->height);
+	point.time = time;
+	parser->proc(parser->userData, &point);
+}
+
+// A slot whose tracking id changed within a report lifts its old contact
+// before its new one lands
+static void ReportSlot(EvdevParser* parser, EvdevSlot* slot, Timestamp time)
+{
+	if (slot->reportedId != -1 && slot->reportedId != slot->trackingId)
+	{
+		EmitPoint(
+			parser, TOUCH_UP, slot->reportedId, slot->reportedX, slot->reportedY, time
+		);
+	}
+
+	if (slot->trackingId != -1)
+	{
+		if (slot->trackingId != slot->reportedId)
+		{
+			EmitPoint(parser, TOUCH_DOWN, slot->trackingId, slot->x, slot->y, time);
+		}
+		else if (slot->x != slot->reportedX || slot->y != slot->reportedY)
+		{
+			EmitPoint(parser, TOUCH_MOVE, slot->trackingId, slot->x, slot->y, time);
+		}
+	}
+
+	slot->reportedId = slot->trackingId;
+	slot->reportedX = slot->x;
+	slot->reportedY = slot->y;
+	slot->changed = false;
+}
+
+// Without querying the device, what changed while events were dropped is
+// unknown. Every contact is lifted so that no key stays held, and those
+// still down come back as downs with their next change.
+static void Resynchronize(EvdevParser* parser, Timestamp time)
+{
+	for (int i = 0; i < MAX_EVDEV_SLOTS; ++i)
+	{
+		EvdevSlot* slot = &parser->slots[i];
+		if (slot->reportedId != -1)
+		{
+			EmitPoint(
+				parser, TOUCH_UP, slot->reportedId, slot->reportedX, slot->reportedY, time
+			);
+		}
+
+		slot->reportedId = -1;
+		slot->changed = false;
+	}
+}
+
+static void ParseSyn(EvdevParser* parser, const EvdevEvent* event)
+{
+	if (event->code == EVDEV_SYN_DROPPED)
+	{
+		parser->dropped = true;
+		return;
+	}
+	if (event->code != EVDEV_SYN_REPORT) { return; }
+
+	if (parser->dropped)
+	{
+		parser->dropped = false;
+		Resynchronize(parser, event->time);
+		return;
+	}
+
+	for (int i = 0; i < MAX_EVDEV_SLOTS; ++i)
+	{
+		EvdevSlot* slot = &parser->slots[i];
+		if (slot->changed) { ReportSlot(parser, slot, event->time); }
+	}
+}
+
+static void ParseAbs(EvdevParser* parser, const EvdevEvent* event)
+{
+	if (event->code == EVDEV_ABS_MT_SLOT)
+	{
+		bool valid = event->value >= 0 && event->value < MAX_EVDEV_SLOTS;
+		parser->slot = valid ? event->value : -1;
+		return;
+	}
+	if (parser->slot < 0) { return; }
+
+	EvdevSlot* slot = &parser->slots[parser->slot];
+	switch (event->code)
+	{
+	case EVDEV_ABS_MT_TRACKING_ID:
+		slot->trackingId = event->value < 0 ? -1 : event->value;
+		break;
+	case EVDEV_ABS_MT_POSITION_X:
+		slot->x = event->value;
+		break;
+	case EVDEV_ABS_MT_POSITION_Y:
+		slot->y = event->value;
+		break;
+	default:
+		return;
+	}
+	slot->changed = true;
+}
+
+void ParseEvdevEvent(EvdevParser* parser, const EvdevEvent* event)
+{
+	if (event->type == EVDEV_SYN)
+	{
+		ParseSyn(parser, event);
+	}
+	else if (event->type == EVDEV_ABS && !parser->dropped)
+	{
+		ParseAbs(parser, event);
+	}
+}
+
+static uint32_t ReadU32(const uint8_t* bytes)
+{
+	return (uint32_t)bytes[0]
+		| (uint32_t)bytes[1] << 8
+		| (uint32_t)bytes[2] << 16
+		| (uint32_t)bytes[3] << 24;
+}
+
+static uint64_t ReadU64(const uint8_t* bytes)
+{
+	return (uint64_t)ReadU32(bytes) | (uint64_t)ReadU32(bytes + 4) << 32;
+}
+
+void DecodeEvdevEvent(const uint8_t* bytes, int size, EvdevEvent* event)
+{
+	// The time is two longs, seconds and microseconds
+	int offset = size == EVDEV_EVENT_SIZE_64 ? 16 : 8;
+	uint64_t seconds = size == EVDEV_EVENT_SIZE_64 ? ReadU64(bytes) : ReadU32(bytes);
+	uint64_t micros = size == EVDEV_EVENT_SIZE_64 ? ReadU64(bytes + 8) : ReadU32(bytes + 4);
+
+	event->time = seconds * 1000000 + micros;
+	event->type = (uint16_t)(bytes[offset] | bytes[offset + 1] << 8);
+	event->code = (uint16_t)(bytes[offset + 2] | bytes[offset + 3] << 8);
+	event->value = (int32_t)ReadU32(bytes + offset + 4);
+}
+
+long PumpEvdev(EvdevParser* parser, FILE* file, int eventSize)
+{
+	uint8_t bytes[EVDEV_EVENT_SIZE_64];
+	long numEvents = 0;
+
+	for (;;)
+	{
+		size_t size = fread(bytes, 1, (size_t)eventSize, file);
+		if (size == 0) { return numEvents; }
+		if (size < (size_t)eventSize) { return -1; }
+
+		EvdevEvent event;
+		DecodeEvdevEvent(bytes, eventSize, &event);
+		ParseEvdevEvent(parser, &event);
+		++numEvents;
+	}
+}
+
+#ifdef _TEST
+
+#include <time.h>
+#include "tracker.h"
+#include "utest.h"
+
+#define MAX_LOGGED_POINTS 32
+// Frames of the capture timed by evdev_benchmark
+#define BENCHMARK_FRAMES 100000
+
+typedef struct
+{
+	int numPoints;
+	TouchPoint points[MAX_LOGGED_POINTS];
+} PointLog;
+
+static void LogPoint(void* userData, const TouchPoint* point)
+{
+	PointLog* log = (PointLog*)userData;
+	if (log->numPoints < MAX_LOGGED_POINTS) { log->points[log->numPoints] = *point; }
+	++log->numPoints;
+}
+
+static bool HasPoint(
+	const PointLog* log, int index, TouchEvent event, uint32_t id, int x, int y
+)
+{
+	const TouchPoint* point = &log->points[index];
+	return point->event == event && point->id == id && point->x == x && point->y == y;
+}
+
+#define MT(code, value) { 0, EVDEV_ABS, EVDEV_ABS_MT_##code, value }
+#define REPORT(time) { time, EVDEV_SYN, EVDEV_SYN_REPORT, 0 }
+
+static const EvdevEvent PARSE_TRACE[] = {
+	// Two fingers land
+	MT(SLOT, 0), MT(TRACKING_ID, 10), MT(POSITION_X, 100), MT(POSITION_Y, 200),
+	MT(SLOT, 1), MT(TRACKING_ID, 11), MT(POSITION_X, 300), MT(POSITION_Y, 400),
+	REPORT(1000),
+	// The second moves, its slot is still selected
+	MT(POSITION_Y, 410),
+	REPORT(2000),
+	// The first lifts while the second moves
+	MT(SLOT, 0), MT(TRACKING_ID, -1),
+	MT(SLOT, 1), MT(POSITION_X, 310),
+	REPORT(3000),
+	// A finger lands where the last one in the slot was, the kernel leaves
+	// out the unchanged position
+	MT(SLOT, 0), MT(TRACKING_ID, 12),
+	REPORT(4000),
+	// A slot reused within a report
+	MT(SLOT, 1), MT(TRACKING_ID, -1), MT(TRACKING_ID, 13), MT(POSITION_X, 500),
+	REPORT(5000),
+	// Slots past the last one are ignored
+	MT(SLOT, 40), MT(TRACKING_ID, 14), MT(POSITION_X, 1),
+	REPORT(6000),
+	// Events dropped by the kernel, up to the next report
+	{ 6500, EVDEV_SYN, EVDEV_SYN_DROPPED, 0 },
+	MT(SLOT, 0), MT(POSITION_X, 999),
+	REPORT(7000),
+	// A contact still down comes back
+	MT(SLOT, 0), MT(POSITION_X, 150),
+	REPORT(8000),
+	// Nothing changed
+	REPORT(9000)
+};
+
+TEST(evdev_parse)
+{
+	PointLog log;
+	log.numPoints = 0;
+	EvdevParser parser;
+	InitEvdevParser(&parser, &LogPoint, &log);
+
+	int numEvents = (int)(sizeof(PARSE_TRACE) / sizeof(PARSE_TRACE[0]));
+	for (int i = 0; i < numEvents; ++i) { ParseEvdevEvent(&parser, &PARSE_TRACE[i]); }
+
+	TEST_ASSERT(log.numPoints == 11);
+	TEST_ASSERT(HasPoint(&log, 0, TOUCH_DOWN, 10, 10000, 20000));
+	TEST_ASSERT(HasPoint(&log, 1, TOUCH_DOWN, 11, 30000, 40000));
+	TEST_ASSERT(log.points[1].time == 1000);
+	TEST_ASSERT(HasPoint(&log, 2, TOUCH_MOVE, 11, 30000, 41000));
+	TEST_ASSERT(HasPoint(&log, 3, TOUCH_UP, 10, 10000, 20000));
+	TEST_ASSERT(HasPoint(&log, 4, TOUCH_MOVE, 11, 31000, 41000));
+	TEST_ASSERT(HasPoint(&log, 5, TOUCH_DOWN, 12, 10000, 20000));
+	TEST_ASSERT(HasPoint(&log, 6, TOUCH_UP, 11, 31000, 41000));
+	TEST_ASSERT(HasPoint(&log, 7, TOUCH_DOWN, 13, 50000, 41000));
+	TEST_ASSERT(HasPoint(&log, 8, TOUCH_UP, 12, 10000, 20000));
+	TEST_ASSERT(HasPoint(&log, 9, TOUCH_UP, 13, 50000, 41000));
+	TEST_ASSERT(log.points[9].time == 7000);
+	TEST_ASSERT(HasPoint(&log, 10, TOUCH_DOWN, 12, 15000, 20000));
+
+	// A 4096 unit panel on a 1920x1080 screen
+	log.numPoints = 0;
+	InitEvdevParser(&parser, &LogPoint, &log);
+	SetEvdevRange(&parser, 0, 4095, 0, 4095, 1920, 1080);
+	const EvdevEvent corner[] = {
+		MT(TRACKING_ID, 1), MT(POSITION_X, 4095), MT(POSITION_Y, 2048), REPORT(0)
+	};
+	for (int i = 0; i < 4; ++i) { ParseEvdevEvent(&parser, &corner[i]); }
+	TEST_ASSERT(log.numPoints == 1);
+	// The right edge is the last pixel of the screen, not one past it
+	TEST_ASSERT(HasPoint(&log, 0, TOUCH_DOWN, 1, 191900, 53963));
+}
+
+// Record events like cat /dev/input/eventN on a little endian machine
+static void WriteEvent(
+	FILE* file, int size, Timestamp time, uint16_t type, uint16_t code, int32_t value
+)
+{
+	uint8_t bytes[EVDEV_EVENT_SIZE_64] = { 0 };
+	int half = size == EVDEV_EVENT_SIZE_64 ? 8 : 4;
+	uint64_t fields[2] = { time / 1000000, time % 1000000 };
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int j = 0; j < half; ++j)
+		{
+			bytes[i * half + j] = (uint8_t)(fields[i] >> (j * 8));
+		}
+	}
+
+	uint32_t data[2] = { (uint32_t)type | (uint32_t)code << 16, (uint32_t)value };
+	for (int i = 0; i < 8; ++i)
+	{
+		bytes[half * 2 + i] = (uint8_t)(data[i / 4] >> ((i % 4) * 8));
+	}
+
+	fwrite(bytes, 1, (size_t)size, file);
+}
+
+static void WriteContact(
+	FILE* file, int size, int slot, int id, int x, int y
+)
+{
+	WriteEvent(file, size, 0, EVDEV_ABS, EVDEV_ABS_MT_SLOT, slot);
+	if (id != 0) { WriteEvent(file, size, 0, EVDEV_ABS, EVDEV_ABS_MT_TRACKING_ID, id); }
+	if (id >= 0)
+	{
+		WriteEvent(file, size, 0, EVDEV_ABS, EVDEV_ABS_MT_POSITION_X, x);
+		WriteEvent(file, size, 0, EVDEV_ABS, EVDEV_ABS_MT_POSITION_Y, y);
+	}
+}
+
+static void WriteReport(FILE* file, int size, Timestamp time)
+{
+	WriteEvent(file, size, time, EVDEV_SYN, EVDEV_SYN_REPORT, 0);
+}
+
+typedef struct
+{
+	int downs[2];
+	int ups[2];
+	int moves;
+} TargetCounts;
+
+static void CountTargetEvent(
+	void* userData, int target, uint32_t id, TouchEvent event, int x, int y
+)
+{
+	TargetCounts* counts = (TargetCounts*)userData;
+	(void)id;
+	(void)x;
+	(void)y;
+
+	if (event == TOUCH_DOWN) { ++counts->downs[target]; }
+	if (event == TOUCH_UP) { ++counts->ups[target]; }
+	if (event == TOUCH_MOVE) { ++counts->moves; }
+}
+
+static void TrackPoint(void* userData, const TouchPoint* point)
+{
+	TrackContact(
+		(TouchTracker*)userData, point->id, point->event, point->x, point->y
+	);
+}
+
+// A thumb sliding from one button onto the next while another finger taps
+// the second one, recorded as a stream of either size
+static void RecordSlide(FILE* file, int size)
+{
+	Timestamp time = 1000000;
+	for (int i = 0; i <= 20; ++i)
+	{
+		WriteContact(file, size, 0, i == 0 ? 1 : 0, 50 + i * 10, 50);
+		if (i == 5) { WriteContact(file, size, 1, 2, 200, 60); }
+		if (i == 8) { WriteContact(file, size, 1, -1, 0, 0); }
+		WriteReport(file, size, time);
+		time += 8333;
+	}
+	WriteContact(file, size, 0, -1, 0, 0);
+	WriteReport(file, size, time);
+}
+
+// Two fingers circling over two buttons for numFrames reports, parsed from
+// a stream. Return the seconds spent parsing, or -1 if no stream could be
+// written.
+static double ReplayCircles(int numFrames, TargetCounts* counts, long* numEvents)
+{
+	FILE* file = tmpfile();
+	if (!file) { return -1.0; }
+
+	for (int i = 0; i < numFrames; ++i)
+	{
+		int phase = i % 64;
+		WriteContact(file, EVDEV_EVENT_SIZE_64, 0, i == 0 ? 1 : 0, 100 + phase, 100);
+		WriteContact(file, EVDEV_EVENT_SIZE_64, 1, i == 0 ? 2 : 0, 300, 100 + phase);
+		WriteReport(file, EVDEV_EVENT_SIZE_64, (Timestamp)i * 8333);
+	}
+	rewind(file);
+
+	TouchTracker tracker;
+	InitTracker(&tracker, &CountTargetEvent, counts);
+	AddTrackerTarget(&tracker, 0, 0, 20000, 20000, TARGET_FOLLOW);
+	AddTrackerTarget(&tracker, 25000, 0, 10000, 20000, TARGET_FOLLOW);
+	EvdevParser parser;
+	InitEvdevParser(&parser, &TrackPoint, &tracker);
+
+	clock_t start = clock();
+	*numEvents = PumpEvdev(&parser, file, EVDEV_EVENT_SIZE_64);
+	clock_t end = clock();
+	fclose(file);
+
+	return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+TEST(evdev_replay)
+{
+	const int sizes[] = { EVDEV_EVENT_SIZE_64, EVDEV_EVENT_SIZE_32 };
+	for (int s = 0; s < 2; ++s)
+	{
+		FILE* file = tmpfile();
+		TEST_ASSERT(file != NULL);
+		RecordSlide(file, sizes[s]);
+		rewind(file);
+
+		TargetCounts counts = { { 0, 0 }, { 0, 0 }, 0 };
+		TouchTracker tracker;
+		InitTracker(&tracker, &CountTargetEvent, &counts);
+		AddTrackerTarget(&tracker, 0, 0, 10000, 10000, 0);
+		AddTrackerTarget(&tracker, 15000, 0, 15000, 10000, TARGET_SLIDE_IN);
+
+		EvdevParser parser;
+		InitEvdevParser(&parser, &TrackPoint, &tracker);
+		long numEvents = PumpEvdev(&parser, file, sizes[s]);
+		TEST_ASSERT(numEvents > 0);
+
+		// The thumb left the first button, slid onto the second and lifted
+		// there, while the tap came and went
+		TEST_ASSERT(counts.downs[0] == 1 && counts.ups[0] == 1);
+		TEST_ASSERT(counts.downs[1] == 2 && counts.ups[1] == 2);
+		TEST_ASSERT(counts.moves > 0);
+		TEST_ASSERT(tracker.numContacts == 0);
+
+		// A stream cut within an event
+		fseek(file, 0, SEEK_END);
+		fputc(0, file);
+		rewind(file);
+		InitEvdevParser(&parser, &TrackPoint, &tracker);
+		TEST_ASSERT(PumpEvdev(&parser, file, sizes[s]) == -1);
+		fclose(file);
+	}
+
+	// Two fingers circling through a capture
+	TargetCounts counts = { { 0, 0 }, { 0, 0 }, 0 };
+	long numEvents;
+	TEST_ASSERT(ReplayCircles(1000, &counts, &numEvents) >= 0.0);
+	// Slot, X and Y per finger and the report, plus the tracking ids
+	TEST_ASSERT(numEvents == 1000 * 7L + 2);
+	TEST_ASSERT(counts.downs[0] == 1 && counts.downs[1] == 1);
+	TEST_ASSERT(counts.moves == (1000 - 1) * 2);
+}
+
+#ifdef _BENCHMARK
+
+TEST(evdev_benchmark)
+{
+	TargetCounts counts = { { 0, 0 }, { 0, 0 }, 0 };
+	long numEvents;
+	double seconds = ReplayCircles(BENCHMARK_FRAMES, &counts, &numEvents);
+	TEST_ASSERT(seconds >= 0.0);
+	TEST_ASSERT(numEvents == BENCHMARK_FRAMES * 7L + 2);
+
+	ReportBenchmark(
+		"evdev_benchmark",
+		"%ld events, %.2f ns per event",
+		numEvents,
+		seconds * 1e9 / (double)numEvents
+	);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef TOUCH_JOY_EVDEV_H
+#define TOUCH_JOY_EVDEV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "touch.h"
+
+#define MAX_EVDEV_SLOTS 16
+// Bytes of a struct input_event on 64 and 32 bit Linux
+#define EVDEV_EVENT_SIZE_64 24
+#define EVDEV_EVENT_SIZE_32 16
+
+// Values from linux/input-event-codes.h, spelled out so that recorded
+// streams can be replayed on any platform
+#define EVDEV_SYN 0x00
+#define EVDEV_ABS 0x03
+#define EVDEV_SYN_REPORT 0
+#define EVDEV_SYN_DROPPED 3
+#define EVDEV_ABS_MT_SLOT 0x2f
+#define EVDEV_ABS_MT_POSITION_X 0x35
+#define EVDEV_ABS_MT_POSITION_Y 0x36
+#define EVDEV_ABS_MT_TRACKING_ID 0x39
+
+typedef struct
+{
+	Timestamp time;
+	uint16_t type;
+	uint16_t code;
+	int32_t value;
+} EvdevEvent;
+
+// Contact in one slot of the device, in device units
+typedef struct
+{
+	// -1 when the slot is empty
+	int trackingId;
+	int x;
+	int y;
+	// Contact and position as of the last report
+	int reportedId;
+	int reportedX;
+	int reportedY;
+	bool changed;
+} EvdevSlot;
+
+// Turns the events of a multitouch device using the type B protocol into
+// contacts. Slots are updated by ABS_MT_* events and their changes are
+// reported together on SYN_REPORT.
+typedef struct
+{
+	EvdevSlot slots[MAX_EVDEV_SLOTS];
+	// Slot receiving ABS_MT_* events, -1 if it is past MAX_EVDEV_SLOTS
+	int slot;
+	// Events are ignored until the next report after the kernel dropped some
+	bool dropped;
+	// Device range mapped onto the screen, in pixels. Device units are
+	// pixels until a range is set.
+	int minX;
+	int maxX;
+	int minY;
+	int maxY;
+	int width;
+	int height;
+	TouchProc proc;
+	void* userData;
+} EvdevParser;
+
+void InitEvdevParser(EvdevParser* parser, TouchProc proc, void* userData);
+void SetEvdevRange(
+	EvdevParser* parser,
+	int minX,
+	int maxX,
+	int minY,
+	int maxY,
+	int width,
+	int height
+);
+// Query the range of a device node. Only available on Linux.
+bool QueryEvdevRange(EvdevParser* parser, FILE* device, int width, int height);
+void ParseEvdevEvent(EvdevParser* parser, const EvdevEvent* event);
+// Decode a little endian struct input_event of EVDEV_EVENT_SIZE_64 or
+// EVDEV_EVENT_SIZE_32 bytes
+void DecodeEvdevEvent(const uint8_t* bytes, int size, EvdevEvent* event);
+// Parse the events of a device node, such as /dev/input/event3, or of a
+// stream recorded from one with cat, until it ends. Return the number of
+// events read or -1 if the stream ends within an event.
+long PumpEvdev(EvdevParser* parser, FILE* file, int eventSize);
+
+#endif
@@ -0,0 +1,194 @@
+#include <math.h>
+#include "filter.h"
+
+#define TWO_PI 6.2831853f
+// Samples closer than this, like those of one touch message, are treated
+// as this far apart
+#define MIN_FILTER_PERIOD 0.001f
+
+// Smoothing factor of an exponential filter with the given cutoff
+static float GetAlpha(float cutoff, float period)
+{
+	float rate = TWO_PI * cutoff * period;
+	return rate / (rate + 1.f);
+}
+
+static float FilterAxis(
+	FilteredAxis* axis, const TouchFilter* filter, float value, float period
+)
+{
+	float speed = (value - axis->value) / period;
+	float alpha = GetAlpha(FILTER_DERIVATIVE_CUTOFF, period);
+	axis->derivative += alpha * (speed - axis->derivative);
+
+	float cutoff = filter->minCutoff + filter->beta * fabsf(axis->derivative);
+	axis->value += GetAlpha(cutoff, period) * (value - axis->value);
+
+	return axis->value;
+}
+
+void InitTouchFilter(TouchFilter* filter)
+{
+	filter->minCutoff = 0.f;
+	filter->beta = 0.f;
+	ResetTouchFilter(filter);
+}
+
+void SetTouchFilter(TouchFilter* filter, float minCutoff, float beta)
+{
+	filter->minCutoff = minCutoff;
+	filter->beta = beta;
+}
+
+bool IsTouchFilterEnabled(const TouchFilter* filter)
+{
+	return filter->minCutoff > 0.f;
+}
+
+void ResetTouchFilter(TouchFilter* filter)
+{
+	filter->primed = false;
+}
+
+void FilterTouch(TouchFilter* filter, float* x, float* y, Timestamp now)
+{
+	if (!IsTouchFilterEnabled(filter)) { return; }
+
+	if (!filter->primed)
+	{
+		filter->primed = true;
+		filter->lastTime = now;
+		filter->x.value = *x;
+		filter->x.derivative = 0.f;
+		filter->y.value = *y;
+		filter->y.derivative = 0.f;
+		return;
+	}
+
+	// Sample times of separate messages may come out of order
+	Timestamp elapsed = now > filter->lastTime ? now - filter->lastTime : 0;
+	float period = (float)elapsed / 1000000.f;
+	if (period < MIN_FILTER_PERIOD) { period = MIN_FILTER_PERIOD; }
+	filter->lastTime = now;
+
+	*x = FilterAxis(&filter->x, filter, *x, period);
+	*y = FilterAxis(&filter->y, filter, *y, period);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+// A 120 Hz digitizer
+#define TRACE_PERIOD 8333
+#define TRACE_LENGTH 480
+
+// Position along a stick's horizontal axis past which its right key is
+// pressed: a 100 pixel stick with a threshold of 50%
+#define STICK_BOUNDARY 75.f
+
+static unsigned int NextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+// A thumb resting right at the edge of the right sector for two seconds,
+// with the digitizer's jitter of about a pixel and a half, then flicking
+// back to the center and over to the right edge
+static void RecordTrace(float* xs, float* ys)
+{
+	unsigned int seed = 7;
+	for (int i = 0; i < TRACE_LENGTH; ++i)
+	{
+		float x;
+		if (i < 240)
+		{
+			x = STICK_BOUNDARY - 0.3f;
+		}
+		else if (i < 360)
+		{
+			x = 50.f;
+		}
+		else if (i < 366)
+		{
+			// Six samples, 50 ms, to cross to the edge
+			x = 50.f + (float)(i - 359) * 7.5f;
+		}
+		else
+		{
+			x = 95.f;
+		}
+
+		float noiseX = (float)(NextRandom(&seed) % 301) / 100.f - 1.5f;
+		float noiseY = (float)(NextRandom(&seed) % 301) / 100.f - 1.5f;
+		xs[i] = x + noiseX;
+		ys[i] = 50.f + noiseY;
+	}
+}
+
+// Count the presses and releases of the right key along the trace, and
+// find the first sample of the flick to the edge which presses it
+static int CountTransitions(
+	TouchFilter* filter, const float* xs, const float* ys, int* flickPress
+)
+{
+	int transitions = 0;
+	bool pressed = false;
+	*flickPress = -1;
+	ResetTouchFilter(filter);
+	for (int i = 0; i < TRACE_LENGTH; ++i)
+	{
+		float x = xs[i];
+		float y = ys[i];
+		FilterTouch(filter, &x, &y, (Timestamp)i * TRACE_PERIOD);
+
+		bool newPressed = x > STICK_BOUNDARY;
+		if (newPressed != pressed) { ++transitions; }
+		if (newPressed && i >= 360 && *flickPress < 0) { *flickPress = i; }
+		pressed = newPressed;
+	}
+
+	return transitions;
+}
+
+TEST(filter_chatter)
+{
+	static float xs[TRACE_LENGTH];
+	static float ys[TRACE_LENGTH];
+	RecordTrace(xs, ys);
+
+	TouchFilter filter;
+	InitTouchFilter(&filter);
+	int rawFlick;
+	int raw = CountTransitions(&filter, xs, ys, &rawFlick);
+
+	SetTouchFilter(&filter, 1.f, 0.02f);
+	int filteredFlick;
+	int filtered = CountTransitions(&filter, xs, ys, &filteredFlick);
+
+	// The jitter at rest stops toggling the key...
+	TEST_ASSERT(raw >= 40);
+	TEST_ASSERT(filtered * 10 <= raw);
+	// ...while the flick still presses it within two samples
+	TEST_ASSERT(rawFlick >= 360);
+	TEST_ASSERT(filteredFlick >= rawFlick);
+	TEST_ASSERT(filteredFlick - rawFlick <= 2);
+
+	// The first sample of a contact is not smoothed toward the last one
+	ResetTouchFilter(&filter);
+	float x = 10.f;
+	float y = 20.f;
+	FilterTouch(&filter, &x, &y, 0);
+	TEST_ASSERT(x == 10.f && y == 20.f);
+	x = 11.f;
+	FilterTouch(&filter, &x, &y, TRACE_PERIOD);
+	TEST_ASSERT(x > 10.f && x < 11.f);
+	// A sample timed before the previous one is still smoothed
+	float previous = x;
+	x = 11.f;
+	FilterTouch(&filter, &x, &y, TRACE_PERIOD / 2);
+	TEST_ASSERT(x > previous && x < 11.f);
+}
+
+#endif
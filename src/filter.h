@@ -0,0 +1,40 @@
+#ifndef TOUCH_JOY_FILTER_H
+#define TOUCH_JOY_FILTER_H
+
+#include <stdbool.h>
+#include "scheduler.h"
+
+// Cutoff of the speed estimate, in hertz
+#define FILTER_DERIVATIVE_CUTOFF 1.f
+
+typedef struct
+{
+	float value;
+	float derivative;
+} FilteredAxis;
+
+// 1€ filter on a touch position: a low-pass filter whose cutoff rises with
+// the finger's speed, removing jitter at rest without lagging behind
+// quick motion. It is disabled until given a cutoff.
+typedef struct
+{
+	// Cutoff at rest in hertz, lower removes more jitter
+	float minCutoff;
+	// Cutoff added per pixel per second of speed, higher lags less
+	float beta;
+
+	bool primed;
+	Timestamp lastTime;
+	FilteredAxis x;
+	FilteredAxis y;
+} TouchFilter;
+
+void InitTouchFilter(TouchFilter* filter);
+void SetTouchFilter(TouchFilter* filter, float minCutoff, float beta);
+bool IsTouchFilterEnabled(const TouchFilter* filter);
+// Forget the previous contact, its first position passes through unchanged
+void ResetTouchFilter(TouchFilter* filter);
+// Smooth a position in pixels in place
+void FilterTouch(TouchFilter* filter, float* x, float* y, Timestamp now);
+
+#endif
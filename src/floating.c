@@ -0,0 +1,96 @@
+#include <math.h>
+#include "floating.h"
+
+void InitFloatingStick(FloatingStick* stick, float radiusX, float radiusY)
+{
+	stick->radiusX = radiusX;
+	stick->radiusY = radiusY;
+	stick->active = false;
+}
+
+void FloatingDown(FloatingStick* stick, float x, float y)
+{
+	stick->active = true;
+	stick->originX = x;
+	stick->originY = y;
+}
+
+void FloatingUp(FloatingStick* stick)
+{
+	stick->active = false;
+}
+
+void GetFloatingDeflection(
+	FloatingStick* stick, float x, float y, float* joyX, float* joyY
+)
+{
+	float deflectionX = (x - stick->originX) / stick->radiusX;
+	float deflectionY = (y - stick->originY) / stick->radiusY;
+
+	if (stick->follow)
+	{
+		// Keep the thumb on the rim, moving the origin straight toward it
+		float distance = sqrtf(deflectionX * deflectionX + deflectionY * deflectionY);
+		if (distance > 1.f)
+		{
+			deflectionX /= distance;
+			deflectionY /= distance;
+			stick->originX = x - deflectionX * stick->radiusX;
+			stick->originY = y - deflectionY * stick->radiusY;
+		}
+	}
+
+	*joyX = deflectionX;
+	*joyY = deflectionY;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(floating_origin)
+{
+	FloatingStick stick;
+	float joyX, joyY;
+
+	// A 100 pixel stick
+	InitFloatingStick(&stick, 50.f, 50.f);
+	stick.follow = false;
+
+	// Landing off-center is no deflection
+	FloatingDown(&stick, 80.f, 20.f);
+	GetFloatingDeflection(&stick, 80.f, 20.f, &joyX, &joyY);
+	TEST_ASSERT(joyX == 0.f && joyY == 0.f);
+
+	GetFloatingDeflection(&stick, 105.f, 20.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyX - 0.5f) < 1e-5f && joyY == 0.f);
+
+	// Without follow, the origin stays put past the radius
+	GetFloatingDeflection(&stick, 180.f, 20.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyX - 2.f) < 1e-5f);
+	GetFloatingDeflection(&stick, 105.f, 20.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyX - 0.5f) < 1e-5f);
+
+	// With follow, the origin trails the thumb so that coming back a little
+	// deflects the other way right away
+	stick.follow = true;
+	FloatingDown(&stick, 80.f, 20.f);
+	GetFloatingDeflection(&stick, 80.f, 120.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyY - 1.f) < 1e-5f && fabsf(joyX) < 1e-5f);
+	TEST_ASSERT(fabsf(stick.originY - 70.f) < 1e-4f);
+
+	GetFloatingDeflection(&stick, 80.f, 60.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyY + 0.2f) < 1e-5f);
+
+	// Diagonals keep their direction
+	FloatingDown(&stick, 0.f, 0.f);
+	GetFloatingDeflection(&stick, 300.f, 400.f, &joyX, &joyY);
+	TEST_ASSERT(fabsf(joyX - 0.6f) < 1e-5f && fabsf(joyY - 0.8f) < 1e-5f);
+	TEST_ASSERT(fabsf(stick.originX - 270.f) < 1e-3f);
+	TEST_ASSERT(fabsf(stick.originY - 360.f) < 1e-3f);
+
+	FloatingUp(&stick);
+	TEST_ASSERT(!stick.active);
+}
+
+#endif
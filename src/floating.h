@@ -0,0 +1,30 @@
+#ifndef TOUCH_JOY_FLOATING_H
+#define TOUCH_JOY_FLOATING_H
+
+#include <stdbool.h>
+
+// Origin of a stick which recenters where the thumb lands, so that landing
+// off-center does not deflect it.
+// Coordinates are in pixels.
+typedef struct
+{
+	// Drag the origin along when the thumb goes past the radius
+	bool follow;
+	// Deflection is 1 at this distance from the origin
+	float radiusX;
+	float radiusY;
+
+	bool active;
+	float originX;
+	float originY;
+} FloatingStick;
+
+void InitFloatingStick(FloatingStick* stick, float radiusX, float radiusY);
+void FloatingDown(FloatingStick* stick, float x, float y);
+void FloatingUp(FloatingStick* stick);
+// Deflection in [-1, 1] on each axis, past 1 when not following
+void GetFloatingDeflection(
+	FloatingStick* stick, float x, float y, float* joyX, float* joyY
+);
+
+#endif
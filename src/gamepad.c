@@ -10,7 +10,7 @@ typedef struct
 	ParseError* error;
 } ParseState;
 
-Button* findOrCreateButton(Gamepad* gamepad, const char* buttonName)
+Button* findButton(Gamepad* gamepad, const char* buttonName)
 {
 	for (int i = 0; i < gamepad->numButtons; ++i)
 	{
@@ -21,12 +21,21 @@ Button* findOrCreateButton(Gamepad* gamepad, const char* buttonName)
 		}
 	}
 
+	return NULL;
+}
+
+Button* findOrCreateButton(Gamepad* gamepad, const char* buttonName)
+{
+	Button* existingButton = findButton(gamepad, buttonName);
+	if (existingButton) { return existingButton; }
+
 	if (gamepad->numButtons == MAX_BUTTONS) { return NULL; }
 
 	Button* button = &gamepad->buttons[gamepad->numButtons];
 	++gamepad->numButtons;
 	memset(button, 0, sizeof(Button));
 	strcpy(button->name, buttonName);
+	InitGestureBindings(&button->gestures);
 
 	return button;
 }
@@ -82,6 +91,54 @@ bool LoadButtonImage(const char* path, Button* button)
 	return bitmap != NULL;
 }
 
+// Gesture bound by a property or -1
+int FindGesture(const char* name)
+{
+	static const char* names[NUM_GESTURES] = {
+		"tap",
+		"double_tap",
+		"long_press",
+		"swipe_up",
+		"swipe_down",
+		"swipe_left",
+		"swipe_right"
+	};
+
+	for (int i = 0; i < NUM_GESTURES; ++i)
+	{
+		if (STR_EQUAL(name, names[i])) { return i; }
+	}
+
+	return -1;
+}
+
+// Whether the button is simply pressed and released, which gestures can
+// stand in for
+bool HasUpDown(const Button* button)
+{
+	switch (button->type)
+	{
+	case BTN_KEY:
+	case BTN_WHEEL:
+	case BTN_QUIT:
+	case BTN_MACRO:
+	case BTN_LAYER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Parses a key code, checking the range before it is narrowed to a WORD
+static bool ParseKeyCodeValue(const char* value, long minCode, WORD* code)
+{
+	long number = TO_NUM(value);
+	if (number < minCode || number >= MAX_KEY_CODES) { return false; }
+
+	*code = (WORD)number;
+	return true;
+}
+
 gb_Ini_HRT GamepadIniHandler(
 	void* data,
 	const char* section,
@@ -100,10 +157,83 @@ gb_Ini_HRT GamepadIniHandler(
 	ParseState* state = (ParseState*)data;
 	Gamepad* gamepad = state->gamepad;
 
+	// Properties before the first section apply to the whole gamepad
+	if (section[0] == '\0')
+	{
+		if (STR_EQUAL(name, "mode"))
+		{
+			if (STR_EQUAL(value, "virtual"))
+			{
+				gamepad->keyMode = KEY_MODE_VIRTUAL;
+			}
+			else if (STR_EQUAL(value, "scancode"))
+			{
+				gamepad->keyMode = KEY_MODE_SCANCODE;
+			}
+			else
+			{
+				RETURN_ERROR("Invalid key mode");
+			}
+		}
+		else
+		{
+			RETURN_ERROR("Invalid gamepad property");
+		}
+
+		return true;
+	}
+
 	Button* button = findOrCreateButton(gamepad, section);
 
 	ENSURE(button, "Too many buttons");
 
+	// Key codes for other layers are suffixed with the layer: keycode.1
+	const char* layerSuffix = strchr(name, '.');
+	if (layerSuffix)
+	{
+		int layer = TO_NUM(layerSuffix + 1);
+		ENSURE(layer > 0 && layer < MAX_LAYERS, "Invalid layer");
+
+		char baseName[16];
+		size_t nameLength = layerSuffix - name;
+		ENSURE(nameLength < sizeof(baseName), "Invalid button property");
+		memcpy(baseName, name, nameLength);
+		baseName[nameLength] = '\0';
+
+		int slot;
+		if (button->type == BTN_KEY && STR_EQUAL(baseName, "keycode"))
+		{
+			slot = 0;
+		}
+		else if (button->type == BTN_STICK && STR_EQUAL(baseName, "keycode_up"))
+		{
+			slot = STICK_UP;
+		}
+		else if (button->type == BTN_STICK && STR_EQUAL(baseName, "keycode_down"))
+		{
+			slot = STICK_DOWN;
+		}
+		else if (button->type == BTN_STICK && STR_EQUAL(baseName, "keycode_left"))
+		{
+			slot = STICK_LEFT;
+		}
+		else if (button->type == BTN_STICK && STR_EQUAL(baseName, "keycode_right"))
+		{
+			slot = STICK_RIGHT;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid button property");
+		}
+
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 1, &code), "Invalid key code");
+
+		int index = (int)(button - gamepad->buttons);
+		gamepad->keymap[layer][index][slot] = code;
+		return true;
+	}
+
 	if (STR_EQUAL(name, "x") || STR_EQUAL(name, "left"))
 	{
 		button->hMargin = TO_NUM(value);
@@ -124,10 +254,45 @@ gb_Ini_HRT GamepadIniHandler(
 		button->vMargin = TO_NUM(value);
 		button->vAnchor = ANCHOR_BOTTOM;
 	}
+	else if (STR_EQUAL(name, "keycode") && button->type == BTN_MOTION)
+	{
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 1, &code), "Invalid key code");
+
+		// A key is played as a one key macro
+		MacroProgram* program = &button->extras.macro.program;
+		program->numOps = 2;
+		program->ops[0].type = MACRO_KEY_DOWN;
+		program->ops[0].arg = code;
+		program->ops[1].type = MACRO_KEY_UP;
+		program->ops[1].arg = code;
+	}
+	else if (STR_EQUAL(name, "keycode") && button->type == BTN_CHORD)
+	{
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.chord.code), "Invalid key code");
+	}
 	else if (STR_EQUAL(name, "keycode"))
 	{
 		ENSURE(button->type == BTN_KEY, "Invalid button property");
-		button->extras.key.code = (WORD)TO_NUM(value);
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.key.code), "Invalid key code");
+	}
+	else if (STR_EQUAL(name, "repeat_delay"))
+	{
+		ENSURE(button->type == BTN_KEY, "Invalid button property");
+
+		int delay = TO_NUM(value);
+		ENSURE(delay > 0, "Invalid repeat delay");
+
+		button->extras.key.repeatDelay = delay;
+	}
+	else if (STR_EQUAL(name, "repeat_rate"))
+	{
+		ENSURE(button->type == BTN_KEY, "Invalid button property");
+
+		int rate = TO_NUM(value);
+		ENSURE(rate >= 0 && rate <= 1000, "Invalid repeat rate");
+
+		button->extras.key.repeatRate = rate;
 	}
 	else if (STR_EQUAL(name, "direction"))
 	{
@@ -155,31 +320,462 @@ gb_Ini_HRT GamepadIniHandler(
 
 		button->extras.wheel.amount = amount;
 	}
+	else if (STR_EQUAL(name, "speed"))
+	{
+		ENSURE(button->type == BTN_WHEEL, "Invalid button property");
+
+		int speed = TO_NUM(value);
+		ENSURE(speed >= 0, "Invalid scroll speed");
+
+		button->extras.wheel.speed = (float)speed;
+	}
+	else if (STR_EQUAL(name, "delay"))
+	{
+		ENSURE(button->type == BTN_WHEEL, "Invalid button property");
+
+		int delay = TO_NUM(value);
+		ENSURE(delay >= 0, "Invalid delay");
+
+		button->extras.wheel.delay = delay;
+	}
+	else if (button->type == BTN_DIAL && STR_EQUAL(name, "keycode_right"))
+	{
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 0, &code), "Invalid key code");
+		button->extras.dial.codes[DIAL_CLOCKWISE] = code;
+	}
+	else if (button->type == BTN_DIAL && STR_EQUAL(name, "keycode_left"))
+	{
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 0, &code), "Invalid key code");
+		button->extras.dial.codes[DIAL_COUNTERCLOCKWISE] = code;
+	}
+	else if (
+		button->type == BTN_SLIDER
+			&& (STR_EQUAL(name, "keycode_up") || STR_EQUAL(name, "keycode_right"))
+	)
+	{
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 0, &code), "Invalid key code");
+		button->extras.slider.codes[SLIDER_INCREASE] = code;
+	}
+	else if (
+		button->type == BTN_SLIDER
+			&& (STR_EQUAL(name, "keycode_down") || STR_EQUAL(name, "keycode_left"))
+	)
+	{
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 0, &code), "Invalid key code");
+		button->extras.slider.codes[SLIDER_DECREASE] = code;
+	}
 	else if (STR_EQUAL(name, "keycode_up"))
 	{
 		ENSURE(button->type == BTN_STICK, "Invalid button property");
-		button->extras.stick.codes[STICK_UP] = (WORD)TO_NUM(value);
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.stick.codes[STICK_UP]), "Invalid key code");
 	}
 	else if (STR_EQUAL(name, "keycode_down"))
 	{
 		ENSURE(button->type == BTN_STICK, "Invalid button property");
-		button->extras.stick.codes[STICK_DOWN] = (WORD)TO_NUM(value);
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.stick.codes[STICK_DOWN]), "Invalid key code");
 	}
 	else if (STR_EQUAL(name, "keycode_left"))
 	{
 		ENSURE(button->type == BTN_STICK, "Invalid button property");
-		button->extras.stick.codes[STICK_LEFT] = (WORD)TO_NUM(value);
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.stick.codes[STICK_LEFT]), "Invalid key code");
 	}
 	else if (STR_EQUAL(name, "keycode_right"))
 	{
 		ENSURE(button->type == BTN_STICK, "Invalid button property");
-		button->extras.stick.codes[STICK_RIGHT] = (WORD)TO_NUM(value);
+		ENSURE(ParseKeyCodeValue(value, 0, &button->extras.stick.codes[STICK_RIGHT]), "Invalid key code");
 	}
 	else if (STR_EQUAL(name, "threshold"))
 	{
 		ENSURE(button->type == BTN_STICK, "Invalid button property");
 		button->extras.stick.threshold = ((float)TO_NUM(value)) / 100.f;
 	}
+	else if (STR_EQUAL(name, "floating"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+		button->extras.stick.floating = TO_BOOL(value);
+	}
+	else if (STR_EQUAL(name, "follow"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+		button->extras.stick.origin.follow = TO_BOOL(value);
+	}
+	else if (STR_EQUAL(name, "zone"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+
+		int zone = TO_NUM(value);
+		ENSURE(zone >= 0, "Invalid zone");
+
+		button->extras.stick.zone = zone;
+	}
+	else if (STR_EQUAL(name, "predict"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+
+		int horizon = TO_NUM(value);
+		ENSURE(horizon >= 0 && horizon <= MAX_PREDICT_HORIZON, "Invalid prediction");
+
+		SetPredictionHorizon(&button->extras.stick.predictor, horizon * 1000ull);
+	}
+	else if (STR_EQUAL(name, "curve"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+
+		const char* curveError;
+		ENSURE(
+			CompileCurve(value, &button->extras.stick.curve, &curveError),
+			curveError
+		);
+	}
+	else if (STR_EQUAL(name, "pwm"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+		button->extras.stick.usePwm = TO_BOOL(value);
+	}
+	else if (STR_EQUAL(name, "frequency"))
+	{
+		ENSURE(button->type == BTN_STICK, "Invalid button property");
+
+		int frequency = TO_NUM(value);
+		ENSURE(frequency > 0 && frequency <= 1000, "Invalid frequency");
+
+		InitPwm(&button->extras.stick.pwm, 1000000 / frequency);
+	}
+	else if (STR_EQUAL(name, "pattern"))
+	{
+		ENSURE(button->type == BTN_MOTION, "Invalid button property");
+
+		const char* motionError;
+		ENSURE(
+			CompileMotion(value, &button->extras.macro.motion, &motionError),
+			motionError
+		);
+	}
+	else if (STR_EQUAL(name, "window") && button->type == BTN_CHORD)
+	{
+		int window = TO_NUM(value);
+		ENSURE(window > 0, "Invalid chord window");
+
+		button->extras.chord.window = window;
+	}
+	else if (STR_EQUAL(name, "window"))
+	{
+		ENSURE(button->type == BTN_MOTION, "Invalid button property");
+
+		int window = TO_NUM(value);
+		ENSURE(window > 0, "Invalid motion window");
+
+		button->extras.macro.motion.window = window;
+	}
+	else if (STR_EQUAL(name, "stick"))
+	{
+		ENSURE(button->type == BTN_MOTION, "Invalid button property");
+
+		// The stick has to be declared first
+		Button* stick = findButton(gamepad, value);
+		ENSURE(stick && stick->type == BTN_STICK, "Unknown stick");
+		ENSURE(stick->extras.stick.numMotions < MAX_STICK_MOTIONS, "Too many motions");
+
+		int index = (int)(button - gamepad->buttons);
+		stick->extras.stick.motions[stick->extras.stick.numMotions++] = index;
+	}
+	else if (STR_EQUAL(name, "buttons"))
+	{
+		ENSURE(button->type == BTN_CHORD, "Invalid button property");
+
+		// Buttons are joined with '+' and have to be declared first
+		uint32_t buttons = 0;
+		int numButtons = 0;
+		const char* start = value;
+		while (*start)
+		{
+			while (*start == ' ') { ++start; }
+
+			const char* end = start;
+			while (*end && *end != '+') { ++end; }
+
+			const char* nameEnd = end;
+			while (nameEnd > start && nameEnd[-1] == ' ') { --nameEnd; }
+
+			char buttonName[GB_INI_MAX_SECTION_LENGTH];
+			size_t length = nameEnd - start;
+			ENSURE(length > 0 && length < sizeof(buttonName), "Unknown button");
+			memcpy(buttonName, start, length);
+			buttonName[length] = '\0';
+
+			Button* member = findButton(gamepad, buttonName);
+			ENSURE(member, "Unknown button");
+			ENSURE(
+				member->type == BTN_KEY
+					|| member->type == BTN_MACRO
+					|| member->type == BTN_LAYER,
+				"Invalid chord button"
+			);
+
+			buttons |= 1u << (int)(member - gamepad->buttons);
+			++numButtons;
+
+			start = *end ? end + 1 : end;
+		}
+
+		ENSURE(numButtons >= 2, "A chord needs at least two buttons");
+		button->extras.chord.buttons = buttons;
+	}
+	else if (STR_EQUAL(name, "layer"))
+	{
+		ENSURE(button->type == BTN_LAYER, "Invalid button property");
+
+		int layer = TO_NUM(value);
+		ENSURE(layer > 0 && layer < MAX_LAYERS, "Invalid layer");
+
+		button->extras.layer.layer = layer;
+	}
+	else if (STR_EQUAL(name, "toggle"))
+	{
+		ENSURE(button->type == BTN_LAYER, "Invalid button property");
+		button->extras.layer.toggle = TO_BOOL(value);
+	}
+	else if (STR_EQUAL(name, "sequence"))
+	{
+		ENSURE(
+			button->type == BTN_MACRO || button->type == BTN_MOTION,
+			"Invalid button property"
+		);
+
+		const char* macroError;
+		ENSURE(
+			CompileMacro(value, &button->extras.macro.program, &macroError),
+			macroError
+		);
+	}
+	else if (STR_EQUAL(name, "hold"))
+	{
+		ENSURE(button->type == BTN_MACRO, "Invalid button property");
+		button->extras.macro.hold = TO_BOOL(value);
+	}
+	else if (STR_EQUAL(name, "sensitivity"))
+	{
+		int sensitivity = TO_NUM(value);
+		ENSURE(sensitivity > 0, "Invalid sensitivity");
+
+		if (button->type == BTN_TRACKPAD)
+		{
+			button->extras.trackpad.sensitivity = (float)sensitivity / 100.f;
+		}
+		else if (button->type == BTN_SLIDER)
+		{
+			button->extras.slider.sensitivity = (float)sensitivity / 100.f;
+		}
+		else if (button->type == BTN_DIAL)
+		{
+			button->extras.dial.sensitivity = (float)sensitivity / 100.f;
+		}
+		else if (button->type == BTN_TRACKBALL)
+		{
+			button->extras.trackball.sensitivity = (float)sensitivity / 100.f;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid button property");
+		}
+	}
+	else if (STR_EQUAL(name, "friction"))
+	{
+		ENSURE(button->type == BTN_TRACKBALL, "Invalid button property");
+
+		int friction = TO_NUM(value);
+		ENSURE(friction > 0 && friction < 100, "Invalid friction");
+
+		SetTrackballFriction(&button->extras.trackball, friction);
+	}
+	else if (STR_EQUAL(name, "orientation"))
+	{
+		ENSURE(button->type == BTN_SLIDER, "Invalid button property");
+
+		if (STR_EQUAL(value, "horizontal"))
+		{
+			button->extras.slider.vertical = false;
+		}
+		else if (STR_EQUAL(value, "vertical"))
+		{
+			button->extras.slider.vertical = true;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid orientation");
+		}
+	}
+	else if (STR_EQUAL(name, "output") && button->type == BTN_DIAL)
+	{
+		if (STR_EQUAL(value, "steps"))
+		{
+			button->extras.dial.mode = DIAL_STEPS;
+		}
+		else if (STR_EQUAL(value, "wheel"))
+		{
+			button->extras.dial.mode = DIAL_WHEEL;
+		}
+		else if (STR_EQUAL(value, "mouse"))
+		{
+			button->extras.dial.mode = DIAL_MOUSE;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid dial output");
+		}
+	}
+	else if (STR_EQUAL(name, "step"))
+	{
+		ENSURE(button->type == BTN_DIAL, "Invalid button property");
+
+		int step = TO_NUM(value);
+		ENSURE(step > 0 && step <= 180, "Invalid dial step");
+
+		button->extras.dial.step = (float)step;
+	}
+	else if (STR_EQUAL(name, "output"))
+	{
+		ENSURE(button->type == BTN_SLIDER, "Invalid button property");
+
+		if (STR_EQUAL(value, "steps"))
+		{
+			button->extras.slider.mode = SLIDER_STEPS;
+		}
+		else if (STR_EQUAL(value, "wheel"))
+		{
+			button->extras.slider.mode = SLIDER_WHEEL;
+		}
+		else if (STR_EQUAL(value, "mouse"))
+		{
+			button->extras.slider.mode = SLIDER_MOUSE;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid slider output");
+		}
+	}
+	else if (STR_EQUAL(name, "detents"))
+	{
+		ENSURE(button->type == BTN_SLIDER, "Invalid button property");
+
+		int detents = TO_NUM(value);
+		ENSURE(detents >= 2 && detents <= MAX_SLIDER_DETENTS, "Invalid number of detents");
+
+		button->extras.slider.numDetents = detents;
+	}
+	else if (STR_EQUAL(name, "acceleration"))
+	{
+		int acceleration = TO_NUM(value);
+		ENSURE(acceleration >= 0, "Invalid acceleration");
+
+		if (button->type == BTN_TRACKPAD)
+		{
+			button->extras.trackpad.acceleration = (float)acceleration / 100.f;
+		}
+		else if (button->type == BTN_WHEEL)
+		{
+			button->extras.wheel.acceleration = (float)acceleration;
+		}
+		else
+		{
+			RETURN_ERROR("Invalid button property");
+		}
+	}
+	else if (STR_EQUAL(name, "row"))
+	{
+		ENSURE(button->type == BTN_KEYBOARD, "Invalid button property");
+
+		const char* rowError;
+		ENSURE(
+			AddKeyboardRow(&button->extras.keyboard, value, &rowError),
+			rowError
+		);
+	}
+	else if (STR_EQUAL(name, "key_width"))
+	{
+		ENSURE(button->type == BTN_KEYBOARD, "Invalid button property");
+
+		int width = TO_NUM(value);
+		ENSURE(width > 0, "Invalid key width");
+
+		button->extras.keyboard.keyWidth = width;
+	}
+	else if (STR_EQUAL(name, "key_height"))
+	{
+		ENSURE(button->type == BTN_KEYBOARD, "Invalid button property");
+
+		int height = TO_NUM(value);
+		ENSURE(height > 0, "Invalid key height");
+
+		button->extras.keyboard.keyHeight = height;
+	}
+	else if (STR_EQUAL(name, "filter_cutoff"))
+	{
+		ENSURE(
+			button->type == BTN_STICK || button->type == BTN_TRACKPAD,
+			"Invalid button property"
+		);
+
+		int cutoff = TO_NUM(value);
+		ENSURE(cutoff >= 0, "Invalid filter cutoff");
+
+		button->filter.minCutoff = (float)cutoff / 100.f;
+	}
+	else if (STR_EQUAL(name, "filter_beta"))
+	{
+		ENSURE(
+			button->type == BTN_STICK || button->type == BTN_TRACKPAD,
+			"Invalid button property"
+		);
+
+		int beta = TO_NUM(value);
+		ENSURE(beta >= 0, "Invalid filter beta");
+
+		button->filter.beta = (float)beta / 1000.f;
+	}
+	else if (FindGesture(name) >= 0)
+	{
+		ENSURE(HasUpDown(button), "Invalid button property");
+
+		WORD code;
+		ENSURE(ParseKeyCodeValue(value, 1, &code), "Invalid key code");
+		BindGesture(&button->gestures, (Gesture)FindGesture(name), code);
+	}
+	else if (STR_EQUAL(name, "long_press_time"))
+	{
+		ENSURE(HasUpDown(button), "Invalid button property");
+
+		int time = TO_NUM(value);
+		ENSURE(time > 0, "Invalid long press time");
+
+		button->gestures.longPressTime = time * 1000ull;
+	}
+	else if (STR_EQUAL(name, "double_tap_time"))
+	{
+		ENSURE(HasUpDown(button), "Invalid button property");
+
+		int time = TO_NUM(value);
+		ENSURE(time > 0, "Invalid double tap time");
+
+		button->gestures.doubleTapTime = time * 1000ull;
+	}
+	else if (STR_EQUAL(name, "swipe_distance"))
+	{
+		ENSURE(HasUpDown(button), "Invalid button property");
+
+		int distance = TO_NUM(value);
+		ENSURE(distance > 0, "Invalid swipe distance");
+
+		button->gestures.swipeDistance = distance * 100;
+	}
+	else if (STR_EQUAL(name, "slide_in"))
+	{
+		button->slideIn = TO_BOOL(value);
+	}
 	else if (STR_EQUAL(name, "image"))
 	{
 		ENSURE(LoadButtonImage(value, button), "Could not load image");
@@ -197,7 +793,7 @@ gb_Ini_HRT GamepadIniHandler(
 		else if (STR_EQUAL(value, "wheel"))
 		{
 			button->type = BTN_WHEEL;
-			button->extras.wheel.amount = 1;
+			InitWheel(&button->extras.wheel);
 		}
 		else if (STR_EQUAL(value, "stick"))
 		{
@@ -207,6 +803,62 @@ gb_Ini_HRT GamepadIniHandler(
 			button->extras.stick.codes[STICK_DOWN] = VK_DOWN;
 			button->extras.stick.codes[STICK_LEFT] = VK_LEFT;
 			button->extras.stick.codes[STICK_RIGHT] = VK_RIGHT;
+			InitPwm(&button->extras.stick.pwm, 100000);
+			InitLinearCurve(&button->extras.stick.curve);
+			InitMotionPredictor(&button->extras.stick.predictor);
+			SetTouchFilter(&button->filter, 0.f, DEFAULT_FILTER_BETA);
+		}
+		else if (STR_EQUAL(value, "macro"))
+		{
+			button->type = BTN_MACRO;
+		}
+		else if (STR_EQUAL(value, "trackball"))
+		{
+			button->type = BTN_TRACKBALL;
+			InitTrackball(&button->extras.trackball);
+		}
+		else if (STR_EQUAL(value, "keyboard"))
+		{
+			button->type = BTN_KEYBOARD;
+			InitKeyboard(&button->extras.keyboard);
+		}
+		else if (STR_EQUAL(value, "dial"))
+		{
+			button->type = BTN_DIAL;
+			InitDial(&button->extras.dial);
+		}
+		else if (STR_EQUAL(value, "slider"))
+		{
+			button->type = BTN_SLIDER;
+			InitSlider(&button->extras.slider);
+		}
+		else if (STR_EQUAL(value, "chord"))
+		{
+			int numChords = 0;
+			for (int i = 0; i < gamepad->numButtons; ++i)
+			{
+				if (gamepad->buttons[i].type == BTN_CHORD) { ++numChords; }
+			}
+			ENSURE(numChords < MAX_CHORDS, "Too many chords");
+
+			button->type = BTN_CHORD;
+			button->extras.chord.window = DEFAULT_CHORD_WINDOW;
+		}
+		else if (STR_EQUAL(value, "layer"))
+		{
+			button->type = BTN_LAYER;
+			button->extras.layer.layer = 1;
+		}
+		else if (STR_EQUAL(value, "motion"))
+		{
+			button->type = BTN_MOTION;
+			button->extras.macro.motion.window = DEFAULT_MOTION_WINDOW;
+		}
+		else if (STR_EQUAL(value, "trackpad"))
+		{
+			button->type = BTN_TRACKPAD;
+			InitTrackpad(&button->extras.trackpad);
+			SetTouchFilter(&button->filter, 0.f, DEFAULT_FILTER_BETA);
 		}
 		else
 		{
@@ -224,9 +876,115 @@ gb_Ini_HRT GamepadIniHandler(
 	return true;
 }
 
+void ResolveScanCodes(Gamepad* gamepad)
+{
+	for (int i = 0; i < MAX_KEY_CODES; ++i)
+	{
+		gamepad->scanCodes[i] = (WORD)MapVirtualKey(i, MAPVK_VK_TO_VSC_EX);
+	}
+}
+
+// Fill layer 0 from the buttons' own codes and let other layers inherit
+// codes they do not override
+void BuildKeymap(Gamepad* gamepad)
+{
+	for (int i = 0; i < gamepad->numButtons; ++i)
+	{
+		Button* button = &gamepad->buttons[i];
+		WORD* baseCodes = gamepad->keymap[0][i];
+
+		if (button->type == BTN_KEY)
+		{
+			baseCodes[0] = button->extras.key.code;
+		}
+		else if (button->type == BTN_STICK)
+		{
+			memcpy(baseCodes, button->extras.stick.codes, sizeof(WORD) * 4);
+		}
+
+		for (int layer = 1; layer < MAX_LAYERS; ++layer)
+		{
+			WORD* codes = gamepad->keymap[layer][i];
+			for (int slot = 0; slot < MAX_BUTTON_CODES; ++slot)
+			{
+				if (codes[slot] == 0) { codes[slot] = baseCodes[slot]; }
+			}
+		}
+	}
+}
+
+// Keyboards without an image are drawn to the size of their grid
+void SizeKeyboards(Gamepad* gamepad)
+{
+	for (int i = 0; i < gamepad->numButtons; ++i)
+	{
+		Button* button = &gamepad->buttons[i];
+		if (button->type != BTN_KEYBOARD || button->image) { continue; }
+
+		button->width = GetKeyboardWidth(&button->extras.keyboard);
+		button->height = GetKeyboardHeight(&button->extras.keyboard);
+	}
+}
+
+// Floating sticks grow by their activation zone on every side, keeping the
+// image where it was placed
+void SizeFloatingSticks(Gamepad* gamepad)
+{
+	for (int i = 0; i < gamepad->numButtons; ++i)
+	{
+		Button* button = &gamepad->buttons[i];
+		if (button->type != BTN_STICK) { continue; }
+
+		InitFloatingStick(
+			&button->extras.stick.origin,
+			(float)button->width / 2.f,
+			(float)button->height / 2.f
+		);
+
+		int zone = button->extras.stick.floating ? button->extras.stick.zone : 0;
+		button->extras.stick.zone = zone;
+		button->extras.stick.knobX = zone;
+		button->extras.stick.knobY = zone;
+		button->extras.stick.drawX = zone;
+		button->extras.stick.drawY = zone;
+		button->width += zone * 2;
+		button->height += zone * 2;
+		button->hMargin -= zone;
+		button->vMargin -= zone;
+	}
+}
+
+// Compile chord buttons into the table used to resolve presses
+void BuildChords(Gamepad* gamepad)
+{
+	InitChordTable(&gamepad->chords);
+
+	for (int i = 0; i < gamepad->numButtons; ++i)
+	{
+		Button* button = &gamepad->buttons[i];
+		if (button->type != BTN_CHORD || button->extras.chord.buttons == 0)
+		{
+			continue;
+		}
+
+		AddChord(
+			&gamepad->chords,
+			button->extras.chord.buttons,
+			button->extras.chord.code,
+			button->extras.chord.window * 1000ull
+		);
+	}
+}
+
 bool LoadGamepad(const char* path, Gamepad* gamepad, ParseError* error)
 {
 	gamepad->numButtons = 0;
+	gamepad->keyMode = KEY_MODE_VIRTUAL;
+	gamepad->scheduler = NULL;
+	gamepad->output = NULL;
+	gamepad->layerMask = 0;
+	gamepad->activeLayer = 0;
+	memset(gamepad->keymap, 0, sizeof(gamepad->keymap));
 
 	ParseState state;
 	state.gamepad = gamepad;
@@ -243,6 +1001,20 @@ bool LoadGamepad(const char* path, Gamepad* gamepad, ParseError* error)
 	// Release all resources created before
 	if (!success) { FreeGamepad(gamepad); }
 
+	if (success)
+	{
+		BuildKeymap(gamepad);
+		BuildChords(gamepad);
+		SizeKeyboards(gamepad);
+		SizeFloatingSticks(gamepad);
+	}
+
+	// Resolve scan codes once so injection never has to look them up
+	if (success && gamepad->keyMode == KEY_MODE_SCANCODE)
+	{
+		ResolveScanCodes(gamepad);
+	}
+
 	return success;
 }
 
@@ -281,4 +1053,12 @@ int GetButtonY(Button* button)
 	default:
 		return 0;
 	}
+}
+
+WORD GetButtonCode(Button* button, int slot)
+{
+	Gamepad* gamepad = button->gamepad;
+	int index = (int)(button - gamepad->buttons);
+
+	return gamepad->keymap[gamepad->activeLayer][index][slot];
 }
\ No newline at end of file
@@ -5,18 +5,65 @@
 #define WIN32_LEAN_AND_MEAN
 #define VC_EXTRALEAN
 #include <Windows.h>
+#include "chord.h"
+#include "curve.h"
+#include "dial.h"
+#include "filter.h"
+#include "floating.h"
+#include "gesture.h"
+#include "keyboard.h"
+#include "macro.h"
+#include "motion.h"
+#include "output.h"
+#include "predict.h"
+#include "pwm.h"
+#include "scheduler.h"
+#include "slider.h"
+#include "touch.h"
+#include "trackball.h"
+#include "tracker.h"
+#include "trackpad.h"
+#include "typematic.h"
+#include "wheel.h"
 
 #define MAX_BUTTONS 32
 #define MAX_ERROR_LENGTH 128
+#define DEFAULT_REPEAT_DELAY 500
+#define DEFAULT_MOTION_WINDOW 300
+#define MAX_STICK_MOTIONS 8
+#define DEFAULT_CHORD_WINDOW 50
+#define MAX_LAYERS 4
+// Key codes per button in each layer: one for keys, one per direction for
+// sticks
+#define MAX_BUTTON_CODES 4
+// Cutoff added per pixel per second of finger speed
+#define DEFAULT_FILTER_BETA 0.02f
+// Milliseconds a stick can look ahead
+#define MAX_PREDICT_HORIZON 50
 
 typedef enum
 {
 	BTN_KEY,
 	BTN_WHEEL,
 	BTN_STICK,
-	BTN_QUIT
+	BTN_QUIT,
+	BTN_MACRO,
+	BTN_TRACKPAD,
+	BTN_MOTION,
+	BTN_LAYER,
+	BTN_CHORD,
+	BTN_SLIDER,
+	BTN_DIAL,
+	BTN_KEYBOARD,
+	BTN_TRACKBALL
 } ButtonType;
 
+typedef enum
+{
+	KEY_MODE_VIRTUAL,
+	KEY_MODE_SCANCODE
+} KeyMode;
+
 typedef enum
 {
 	ANCHOR_LEFT,
@@ -37,6 +84,9 @@ typedef enum
 	STICK_RIGHT
 } StickDirection;
 
+typedef struct Gamepad Gamepad;
+typedef struct InputChannel InputChannel;
+
 typedef struct
 {
 	ButtonType type;
@@ -49,6 +99,15 @@ typedef struct
 	HBITMAP image;
 	COLORREF colorKey;
 	HWND window;
+	Gamepad* gamepad;
+	// Finger driving the button
+	TouchCapture capture;
+	// Pressed by a finger sliding onto it from elsewhere
+	bool slideIn;
+	// Smooths the finger driving a stick or trackpad
+	TouchFilter filter;
+	// Replace the button's own press when any is bound
+	GestureBindings gestures;
 	char name[GB_INI_MAX_SECTION_LENGTH];
 	union
 	{
@@ -56,28 +115,112 @@ typedef struct
 		{
 			WORD code;
 			bool sticky;
+			// Milliseconds before auto repeat starts, 0 for the default
+			int repeatDelay;
+			// Repeats per second, 0 disables auto repeat
+			int repeatRate;
+			// Code output on press, in case the layer changes before release
+			WORD pressedCode;
 		} key;
 
-		struct
-		{
-			int direction;
-			DWORD amount;
-		} wheel;
+		Wheel wheel;
 
 		struct
 		{
 			float threshold;
 			WORD codes[4];
 			bool states[4];
+			WORD pressedCodes[4];
+			// Applied to the deflection on each axis
+			Curve curve;
+			// Looks ahead of the finger to make up for the digitizer's delay
+			MotionPredictor predictor;
+			// Measure deflection from where the thumb lands instead of the
+			// center of the image
+			bool floating;
+			FloatingStick origin;
+			// Pixels around the image where a floating stick can be touched,
+			// included in the button's size
+			int zone;
+			// Where the input thread last placed the image in the window
+			int knobX;
+			int knobY;
+			// Where the window thread draws it, following knobX and knobY
+			int drawX;
+			int drawY;
+			// Modulate key presses by deflection instead of holding them
+			bool usePwm;
+			Pwm pwm;
+			MotionHistory history;
+			// Indices of the motion buttons watching this stick
+			int numMotions;
+			int motions[MAX_STICK_MOTIONS];
 		} stick;
+
+		// Also used by motion buttons, which play their macro when a stick
+		// motion is recognized instead of when touched
+		struct
+		{
+			bool hold;
+			MacroProgram program;
+			MacroPlayer player;
+			MotionPattern motion;
+		} macro;
+
+		struct
+		{
+			int layer;
+			// Toggle on press instead of being active while held
+			bool toggle;
+		} layer;
+
+		struct
+		{
+			// Bit i is set for each button i of the chord
+			uint32_t buttons;
+			WORD code;
+			// Milliseconds between the first and last press
+			int window;
+		} chord;
+
+		Trackpad trackpad;
+		Slider slider;
+		Dial dial;
+		Keyboard keyboard;
+		Trackball trackball;
 	} extras;
 } Button;
 
-typedef struct
+struct Gamepad
 {
 	int numButtons;
 	Button buttons[MAX_BUTTONS];
-} Gamepad;
+	KeyMode keyMode;
+	// Scan code of each virtual key, resolved at load in scan code mode.
+	// The high byte is non-zero for extended keys.
+	WORD scanCodes[MAX_KEY_CODES];
+	Scheduler* scheduler;
+	Output* output;
+	Typematic typematic;
+	// Key codes of every button in every layer, built at load so that
+	// switching layer is only an index change. Layer 0 holds the codes
+	// from the button's own properties.
+	WORD keymap[MAX_LAYERS][MAX_BUTTONS][MAX_BUTTON_CODES];
+	// Layers enabled by layer buttons, the highest one is active
+	unsigned int layerMask;
+	int activeLayer;
+	ChordTable chords;
+	// Every contact on the gamepad, whichever window received it
+	TouchTracker tracker;
+	GestureRecognizer gestures;
+	// Carries input to the input thread and knob positions back
+	InputChannel* channel;
+	// Bit i is set when the knob of stick i moved since it was last sent to
+	// the window thread
+	uint32_t movedKnobs;
+	// When the contact being handled was sampled
+	Timestamp touchTime;
+};
 
 typedef struct
 {
@@ -89,5 +232,7 @@ bool LoadGamepad(const char* path, Gamepad* gamepad, ParseError* error);
 void FreeGamepad(Gamepad* gamepad);
 int GetButtonX(Button* button);
 int GetButtonY(Button* button);
+// Code of a key button (slot 0) or stick direction in the active layer
+WORD GetButtonCode(Button* button, int slot);
 
 #endif
\ No newline at end of file
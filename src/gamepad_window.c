@@ -4,19 +4,66 @@
 #define VC_EXTRALEAN
 #include <Windows.h>
 #include <windowsx.h>
+#include <math.h>
 
 #include "utils.h"
 
 #define MOUSEEVENTF_FROMTOUCH 0xFF515700
+// Contact id used for the mouse on keyboards
+#define MOUSE_CONTACT_ID 0xFFFFFFFF
 #define BUTTON(HWND, VAR) \
 	Button* VAR = (Button*)GetWindowLongPtr(HWND, GWLP_USERDATA);
 
-typedef enum
+// Room for this many inputs of a WM_TOUCH message is made up front
+#define INITIAL_TOUCH_INPUTS 32
+// Milliseconds a touch message can wait in the queue before it is
+// considered part of a backlog
+#define TOUCH_BACKLOG_TIME 20
+// Touch sample times further back than this many milliseconds are not
+// trusted
+#define MAX_TOUCH_AGE 1000
+
+// Draw the whole grid of a keyboard, labelled with the system's key names
+void PaintKeyboard(HDC hdc, Button* button)
 {
-	TOUCH_DOWN,
-	TOUCH_UP,
-	TOUCH_MOVE
-} TouchEvent;
+	const Keyboard* keyboard = &button->extras.keyboard;
+
+	RECT bounds = { 0, 0, button->width, button->height };
+	HBRUSH background = CreateSolidBrush(RGB(32, 32, 32));
+	HBRUSH keyBrush = CreateSolidBrush(RGB(80, 80, 80));
+	FillRect(hdc, &bounds, background);
+
+	SetBkMode(hdc, TRANSPARENT);
+	SetTextColor(hdc, RGB(255, 255, 255));
+
+	for (int i = 0; i < keyboard->numRows; ++i)
+	{
+		const KeyboardRow* row = &keyboard->rows[i];
+		for (int j = 0; j < row->numKeys; ++j)
+		{
+			RECT key;
+			key.left = row->starts[j] * keyboard->keyWidth / KEYBOARD_SUBDIVISIONS + 2;
+			key.right = (row->starts[j] + row->widths[j])
+				* keyboard->keyWidth / KEYBOARD_SUBDIVISIONS - 2;
+			key.top = i * keyboard->keyHeight + 2;
+			key.bottom = (i + 1) * keyboard->keyHeight - 2;
+			FillRect(hdc, &key, keyBrush);
+
+			char label[32];
+			UINT scanCode = MapVirtualKey(row->codes[j], MAPVK_VK_TO_VSC);
+			if (GetKeyNameText((LONG)(scanCode << 16), label, sizeof(label)) > 0)
+			{
+				DrawText(
+					hdc, label, -1, &key,
+					DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS
+				);
+			}
+		}
+	}
+
+	DeleteObject(keyBrush);
+	DeleteObject(background);
+}
 
 LRESULT CALLBACK Paint(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -28,91 +75,328 @@ LRESULT CALLBACK Paint(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 	PAINTSTRUCT ps;
 	HDC hdc = BeginPaint(hWnd, &ps);
+
+	if (button->type == BTN_KEYBOARD && !button->image)
+	{
+		PaintKeyboard(hdc, button);
+		EndPaint(hWnd, &ps);
+		return 0;
+	}
+
+	int x = 0;
+	int y = 0;
+	int width = button->width;
+	int height = button->height;
+	if (button->type == BTN_STICK && button->extras.stick.zone > 0)
+	{
+		// The activation zone of a floating stick is drawn as a faint pad
+		// so that it takes touches instead of letting them through
+		RECT bounds = { 0, 0, button->width, button->height };
+		HBRUSH zoneBrush = CreateSolidBrush(RGB(48, 48, 48));
+		FillRect(hdc, &bounds, zoneBrush);
+		DeleteObject(zoneBrush);
+
+		x = button->extras.stick.drawX;
+		y = button->extras.stick.drawY;
+		width -= button->extras.stick.zone * 2;
+		height -= button->extras.stick.zone * 2;
+	}
+
 	HDC buttonDC = CreateCompatibleDC(hdc);
 	SelectObject(buttonDC, button->image);
-	BitBlt(hdc, 0, 0, button->width, button->height, buttonDC, 0, 0, SRCCOPY);
+	BitBlt(hdc, x, y, width, height, buttonDC, 0, 0, SRCCOPY);
 	DeleteDC(buttonDC);
 	EndPaint(hWnd, &ps);
 
 	return 0;
 }
 
+void SendInputSink(void* userData, const OutputEvent* events, int numEvents)
+{
+	const Gamepad* gamepad = (const Gamepad*)userData;
+	bool useScanCodes = gamepad->keyMode == KEY_MODE_SCANCODE;
+
+	INPUT inputs[MAX_OUTPUT_EVENTS];
+
+	for (int i = 0; i < numEvents; ++i)
+	{
+		const OutputEvent* event = &events[i];
+		INPUT* input = &inputs[i];
+
+		switch (event->type)
+		{
+		case OUTPUT_KEY:
+			input->type = INPUT_KEYBOARD;
+			input->ki.wVk = event->data.key.code;
+			input->ki.wScan = 0;
+			input->ki.dwFlags = event->data.key.down ? 0 : KEYEVENTF_KEYUP;
+			input->ki.time = 0;
+			input->ki.dwExtraInfo = 0;
+
+			// DirectInput and raw input games only see scan codes
+			WORD scanCode = useScanCodes
+				? gamepad->scanCodes[event->data.key.code]
+				: 0;
+			if (scanCode != 0)
+			{
+				input->ki.wVk = 0;
+				input->ki.wScan = scanCode & 0xFF;
+				input->ki.dwFlags |= KEYEVENTF_SCANCODE;
+				if (scanCode & 0xFF00)
+				{
+					input->ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+				}
+			}
+			break;
+		case OUTPUT_MOUSE_MOVE:
+			input->type = INPUT_MOUSE;
+			input->mi.dx = event->data.move.dx;
+			input->mi.dy = event->data.move.dy;
+			input->mi.mouseData = 0;
+			input->mi.dwFlags = MOUSEEVENTF_MOVE;
+			input->mi.time = 0;
+			input->mi.dwExtraInfo = 0;
+			break;
+		case OUTPUT_MOUSE_ABSOLUTE:
+			input->type = INPUT_MOUSE;
+			input->mi.dx = event->data.position.x;
+			input->mi.dy = event->data.position.y;
+			input->mi.mouseData = 0;
+			input->mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+			input->mi.time = 0;
+			input->mi.dwExtraInfo = 0;
+			break;
+		case OUTPUT_WHEEL:
+			input->type = INPUT_MOUSE;
+			input->mi.dx = 0;
+			input->mi.dy = 0;
+			input->mi.mouseData = (DWORD)event->data.wheel.delta;
+			input->mi.dwFlags = MOUSEEVENTF_WHEEL;
+			input->mi.time = 0;
+			input->mi.dwExtraInfo = 0;
+			break;
+		}
+	}
+
+	SendInput(numEvents, inputs, sizeof(INPUT));
+}
+
 void HandleKeyButton(Button* button, bool down)
 {
-	KEYBDINPUT kbInput;
-	kbInput.wVk = button->extras.key.code;
-	kbInput.wScan = 0;
-	kbInput.dwFlags = down ? 0 : KEYEVENTF_KEYUP;
-	kbInput.time = 0;
-	kbInput.dwExtraInfo = 0;
+	Gamepad* gamepad = button->gamepad;
+	int repeatRate = button->extras.key.repeatRate;
+
+	if (down)
+	{
+		WORD code = GetButtonCode(button, 0);
+		button->extras.key.pressedCode = code;
+		OutputKey(gamepad->output, code, true);
 
-	INPUT input;
-	input.type = INPUT_KEYBOARD;
-	input.ki = kbInput;
+		if (repeatRate > 0)
+		{
+			int repeatDelay = button->extras.key.repeatDelay
+				? button->extras.key.repeatDelay
+				: DEFAULT_REPEAT_DELAY;
+			StartRepeat(
+				&gamepad->typematic,
+				button,
+				code,
+				repeatDelay * 1000ull,
+				1000000 / repeatRate,
+				GetTimestamp()
+			);
+		}
+	}
+	else
+	{
+		if (repeatRate > 0) { StopRepeat(&gamepad->typematic, button); }
 
-	SendInput(1, &input, sizeof(INPUT));
+		// Release what was pressed even if the layer has changed since
+		OutputKey(gamepad->output, button->extras.key.pressedCode, false);
+		button->extras.key.pressedCode = 0;
+	}
 }
 
+// Buttons are handled on the input thread, the message loop to end is the
+// window thread's
 void HandleQuitButton(Button* button, bool down)
 {
-	UNUSED(button);
-
-	if (!down) { PostQuitMessage(0); }
+	if (!down)
+	{
+		PostThreadMessage(button->gamepad->channel->windowThread, WM_QUIT, 0, 0);
+	}
 }
 
 void HandleWheelButton(Button* button, bool down)
 {
-	if (!down) { return; }
+	Wheel* wheel = &button->extras.wheel;
 
-	// Scrolling is a bit tricky.
-	// First we need to move the mouse to the target area.
-	// Then we simulate a scroll event.
-	INPUT inputs[2];
+	if (down)
+	{
+		WheelDown(
+			wheel, button->gamepad->scheduler, button->gamepad->output, GetTimestamp()
+		);
+	}
+	else
+	{
+		WheelUp(wheel);
+	}
+}
 
-	// Move the mouse to a point slightly above and to the left of the button's
-	// top left corner
-	inputs[0].type = INPUT_MOUSE;
+// Scrolling is a bit tricky: wheel events go to the window under the cursor
+// so the cursor has to be moved to the target area first. The target does not
+// change while a layout is loaded so it is computed once.
+void ComputeWheelTarget(Button* button)
+{
+	// Aim at a point slightly above and to the left of the button's top left
+	// corner
 	int x = GetButtonX(button) - 5;
 	int y = GetButtonY(button) - 5;
 	// Windows uses a weird coordinate system for mouse: [0, 65535]
-	int absX = (int)((float)x / (float)GetSystemMetrics(SM_CXSCREEN) * 65535.f);
-	int absY = (int)((float)y / (float)GetSystemMetrics(SM_CYSCREEN) * 65535.f);
-	inputs[0].mi.dx = absX;
-	inputs[0].mi.dy = absY;
-	inputs[0].mi.mouseData = 0;
-	inputs[0].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-	inputs[0].mi.time = 0;
-	inputs[0].mi.dwExtraInfo = 0;
-
-	// Scroll
-	inputs[1].type = INPUT_MOUSE;
-	inputs[1].mi.dx = 0;
-	inputs[1].mi.dy = 0;
-	inputs[1].mi.mouseData = WHEEL_DELTA * button->extras.wheel.direction * button->extras.wheel.amount;
-	inputs[1].mi.dwFlags = MOUSEEVENTF_WHEEL;
-	inputs[1].mi.time = 0;
-	inputs[1].mi.dwExtraInfo = 0;
-
-	SendInput(2, inputs, sizeof(INPUT));
+	Wheel* wheel = &button->extras.wheel;
+	wheel->targetX = (int)((float)x / (float)GetSystemMetrics(SM_CXSCREEN) * 65535.f);
+	wheel->targetY = (int)((float)y / (float)GetSystemMetrics(SM_CYSCREEN) * 65535.f);
+}
+
+// Past the threshold, the duty cycle grows with the deflection until the key
+// is fully held at the edge
+float GetStickDuty(Button* button, float deflection)
+{
+	float threshold = button->extras.stick.threshold;
+	if (threshold >= 1.f) { return 0.f; }
+
+	return (fabsf(deflection) - threshold) / (1.f - threshold);
+}
+
+void HandleStickPwm(Button* button, float joyX, float joyY)
+{
+	Pwm* pwm = &button->extras.stick.pwm;
+
+	SetPwmDuty(
+		pwm, 0,
+		GetButtonCode(button, joyX < 0.f ? STICK_LEFT : STICK_RIGHT),
+		GetStickDuty(button, joyX)
+	);
+	SetPwmDuty(
+		pwm, 1,
+		GetButtonCode(button, joyY < 0.f ? STICK_UP : STICK_DOWN),
+		GetStickDuty(button, joyY)
+	);
+	UpdatePwm(
+		pwm, button->gamepad->scheduler, button->gamepad->output, GetTimestamp()
+	);
+}
+
+void RecognizeMotions(Button* stick, const bool* states)
+{
+	Gamepad* gamepad = stick->gamepad;
+	MotionHistory* history = &stick->extras.stick.history;
+
+	int direction = GetStickDirection(
+		states[STICK_UP], states[STICK_DOWN], states[STICK_LEFT], states[STICK_RIGHT]
+	);
+	// Charges and windows are timed by when the touches were sampled, as
+	// queued touches are handled together
+	if (!PushMotion(history, direction, gamepad->touchTime)) { return; }
+
+	for (int i = 0; i < stick->extras.stick.numMotions; ++i)
+	{
+		Button* motion = &gamepad->buttons[stick->extras.stick.motions[i]];
+		if (MatchMotion(&motion->extras.macro.motion, history))
+		{
+			StartMacro(
+				&motion->extras.macro.player,
+				&motion->extras.macro.program,
+				gamepad->scheduler,
+				gamepad->output,
+				GetTimestamp()
+			);
+		}
+	}
+}
+
+// Place a floating stick's image centered on its origin, or back in place
+// when released. The window itself does not move, the window thread redraws
+// it once sent the new position.
+void MoveKnob(Button* button)
+{
+	const FloatingStick* origin = &button->extras.stick.origin;
+	int zone = button->extras.stick.zone;
+	int knobX = zone;
+	int knobY = zone;
+
+	if (origin->active)
+	{
+		int maxX = zone * 2;
+		int maxY = zone * 2;
+		knobX = (int)(origin->originX - origin->radiusX + 0.5f);
+		knobY = (int)(origin->originY - origin->radiusY + 0.5f);
+		knobX = knobX < 0 ? 0 : (knobX > maxX ? maxX : knobX);
+		knobY = knobY < 0 ? 0 : (knobY > maxY ? maxY : knobY);
+	}
+
+	if (knobX == button->extras.stick.knobX && knobY == button->extras.stick.knobY)
+	{
+		return;
+	}
+
+	Gamepad* gamepad = button->gamepad;
+	button->extras.stick.knobX = knobX;
+	button->extras.stick.knobY = knobY;
+	gamepad->movedKnobs |= 1u << (int)(button - gamepad->buttons);
 }
 
 void HandleStickButton(Button* button, TouchEvent event, int touchX, int touchY)
 {
 	float joyX, joyY;
+	FloatingStick* origin = &button->extras.stick.origin;
 
 	if (event == TOUCH_UP)
 	{
 		// If the touch is released, the stick moves to its center position
 		joyX = 0.f;
 		joyY = 0.f;
+
+		if (button->extras.stick.floating)
+		{
+			FloatingUp(origin);
+			MoveKnob(button);
+		}
 	}
 	else
 	{
 		// In other cases, use the real touch position to calculate stick
-		// position
+		// position, smoothed so that jitter does not toggle keys at the
+		// threshold
+		if (event == TOUCH_DOWN)
+		{
+			ResetTouchFilter(&button->filter);
+			ResetMotionPredictor(&button->extras.stick.predictor);
+		}
+
+		float x = (float)touchX;
+		float y = (float)touchY;
+		// Both are timed by when the digitizer sampled the touch, not by when
+		// it is handled, as queued touches are handled together
+		Timestamp sampled = button->gamepad->touchTime;
+		FilterTouch(&button->filter, &x, &y, sampled);
+		// Quick direction changes press keys sooner when looking ahead
+		PredictTouch(&button->extras.stick.predictor, &x, &y, sampled);
 
-		joyX = (float)touchX / (float)button->width * 2.f - 1.f;
-		joyY = (float)touchY / (float)button->height * 2.f - 1.f;
+		if (button->extras.stick.floating)
+		{
+			if (event == TOUCH_DOWN) { FloatingDown(origin, x, y); }
+
+			GetFloatingDeflection(origin, x, y, &joyX, &joyY);
+			MoveKnob(button);
+		}
+		else
+		{
+			joyX = x / (float)button->width * 2.f - 1.f;
+			joyY = y / (float)button->height * 2.f - 1.f;
+		}
+		joyX = ApplyCurve(&button->extras.stick.curve, joyX);
+		joyY = ApplyCurve(&button->extras.stick.curve, joyY);
 	}
 
 	bool newStates[4];
@@ -122,29 +406,191 @@ void HandleStickButton(Button* button, TouchEvent event, int touchX, int touchY)
 	newStates[STICK_LEFT]  = joyX < -threshold;
 	newStates[STICK_RIGHT] = joyX >  threshold;
 
-	INPUT inputs[4];
-	int numInputs = 0;
+	RecognizeMotions(button, newStates);
+
+	if (button->extras.stick.usePwm)
+	{
+		HandleStickPwm(button, joyX, joyY);
+		return;
+	}
 
+	WORD* pressedCodes = button->extras.stick.pressedCodes;
 	for (int i = 0; i < 4; ++i)
 	{
 		if (newStates[i] != button->extras.stick.states[i])
 		{
-			INPUT* input = &inputs[numInputs++];
-			input->type = INPUT_KEYBOARD;
-			input->ki.wVk = button->extras.stick.codes[i];
-			input->ki.dwFlags = newStates[i] ? 0 : KEYEVENTF_KEYUP;
-			input->ki.wScan = 0;
-			input->ki.time = 0;
-			input->ki.dwExtraInfo = 0;
+			if (newStates[i]) { pressedCodes[i] = GetButtonCode(button, i); }
+
+			OutputKey(button->gamepad->output, pressedCodes[i], newStates[i]);
 		}
 
 		button->extras.stick.states[i] = newStates[i];
 	}
+}
+
+void HandleTrackpadButton(Button* button, TouchEvent event, int touchX, int touchY)
+{
+	Trackpad* trackpad = &button->extras.trackpad;
+	// Speed is measured between the times the touches were sampled
+	Timestamp now = button->gamepad->touchTime;
+
+	if (event == TOUCH_DOWN) { ResetTouchFilter(&button->filter); }
+	if (IsTouchFilterEnabled(&button->filter))
+	{
+		float x = (float)touchX / 100.f;
+		float y = (float)touchY / 100.f;
+		FilterTouch(&button->filter, &x, &y, now);
+		touchX = (int)(x * 100.f);
+		touchY = (int)(y * 100.f);
+	}
+
+	switch (event)
+	{
+	case TOUCH_DOWN:
+		TrackpadDown(trackpad, touchX, touchY, now);
+		break;
+	case TOUCH_MOVE:
+		TrackpadMove(trackpad, button->gamepad->output, touchX, touchY, now);
+		break;
+	case TOUCH_UP:
+		TrackpadMove(trackpad, button->gamepad->output, touchX, touchY, now);
+		TrackpadUp(trackpad);
+		break;
+	}
+}
 
-	SendInput(numInputs, inputs, sizeof(INPUT));
+void HandleTrackballButton(Button* button, TouchEvent event, int touchX, int touchY)
+{
+	Trackball* trackball = &button->extras.trackball;
+	Gamepad* gamepad = button->gamepad;
+	Timestamp now = GetTimestamp();
+
+	switch (event)
+	{
+	case TOUCH_DOWN:
+		TrackballDown(trackball, touchX, touchY, now);
+		break;
+	case TOUCH_MOVE:
+		TrackballMove(trackball, gamepad->output, touchX, touchY, now);
+		break;
+	case TOUCH_UP:
+		TrackballMove(trackball, gamepad->output, touchX, touchY, now);
+		TrackballUp(trackball, gamepad->scheduler, gamepad->output, now);
+		break;
+	}
 }
 
-void HandleUpDown(Button* button, bool down)
+// Where the button is on screen, in hundredths of a pixel. It is resolved
+// by PlaceButton so that touches do not query the screen size.
+const GridRect* GetButtonBounds(Button* button)
+{
+	Gamepad* gamepad = button->gamepad;
+	return &gamepad->tracker.bounds[button - gamepad->buttons];
+}
+
+void HandleSliderButton(Button* button, TouchEvent event, int touchX, int touchY)
+{
+	Slider* slider = &button->extras.slider;
+	Scheduler* scheduler = button->gamepad->scheduler;
+	Output* output = button->gamepad->output;
+	Timestamp now = GetTimestamp();
+
+	// Vertical tracks go up from the bottom edge like a throttle
+	const GridRect* bounds = GetButtonBounds(button);
+	int position = slider->vertical ? bounds->bottom - touchY : touchX - bounds->left;
+
+	switch (event)
+	{
+	case TOUCH_DOWN:
+		SliderDown(slider, scheduler, output, position, now);
+		break;
+	case TOUCH_MOVE:
+		SliderMove(slider, scheduler, output, position, now);
+		break;
+	case TOUCH_UP:
+		SliderMove(slider, scheduler, output, position, now);
+		SliderUp(slider);
+		break;
+	}
+}
+
+void HandleDialButton(Button* button, TouchEvent event, int touchX, int touchY)
+{
+	Dial* dial = &button->extras.dial;
+	Scheduler* scheduler = button->gamepad->scheduler;
+	Output* output = button->gamepad->output;
+	Timestamp now = GetTimestamp();
+
+	switch (event)
+	{
+	case TOUCH_DOWN:
+		DialDown(dial, touchX, touchY);
+		break;
+	case TOUCH_MOVE:
+		DialMove(dial, scheduler, output, touchX, touchY, now);
+		break;
+	case TOUCH_UP:
+		DialMove(dial, scheduler, output, touchX, touchY, now);
+		DialUp(dial);
+		break;
+	}
+}
+
+void HandleMacroButton(Button* button, bool down)
+{
+	MacroPlayer* player = &button->extras.macro.player;
+
+	if (down)
+	{
+		// Pressing again while a run is in progress restarts it
+		StartMacro(
+			player,
+			&button->extras.macro.program,
+			button->gamepad->scheduler,
+			button->gamepad->output,
+			GetTimestamp()
+		);
+	}
+	else if (button->extras.macro.hold)
+	{
+		CancelMacro(player);
+	}
+}
+
+// Held layers are active while their button is down, toggled ones until
+// pressed again. Keys already down keep their code until released.
+void HandleLayerButton(Button* button, bool down)
+{
+	Gamepad* gamepad = button->gamepad;
+	unsigned int bit = 1u << button->extras.layer.layer;
+
+	if (button->extras.layer.toggle)
+	{
+		if (!down) { return; }
+
+		gamepad->layerMask ^= bit;
+	}
+	else if (down)
+	{
+		gamepad->layerMask |= bit;
+	}
+	else
+	{
+		gamepad->layerMask &= ~bit;
+	}
+
+	gamepad->activeLayer = 0;
+	for (int layer = MAX_LAYERS - 1; layer > 0; --layer)
+	{
+		if (gamepad->layerMask & (1u << layer))
+		{
+			gamepad->activeLayer = layer;
+			break;
+		}
+	}
+}
+
+void DispatchUpDown(Button* button, bool down)
 {
 	switch (button->type)
 	{
@@ -157,48 +603,353 @@ void HandleUpDown(Button* button, bool down)
 	case BTN_QUIT:
 		HandleQuitButton(button, down);
 		break;
+	case BTN_MACRO:
+		HandleMacroButton(button, down);
+		break;
+	case BTN_LAYER:
+		HandleLayerButton(button, down);
+		break;
 	}
 }
 
-LRESULT CALLBACK OnTouch(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+// Receives presses held back by the chord table which did not form a chord
+void PassChordButton(void* userData, int button, bool down)
 {
-	BUTTON(hWnd, button);
-	TOUCHINPUT touch; //Only handle the first touch on any button
+	Gamepad* gamepad = (Gamepad*)userData;
+
+	DispatchUpDown(&gamepad->buttons[button], down);
+}
+
+void HandleUpDown(Button* button, bool down)
+{
+	Gamepad* gamepad = button->gamepad;
+	int index = (int)(button - gamepad->buttons);
+
+	bool taken = down
+		? ChordPress(&gamepad->chords, index, GetTimestamp())
+		: ChordRelease(&gamepad->chords, index);
+	if (taken) { return; }
+
+	DispatchUpDown(button, down);
+}
+
+// Buttons with gestures output nothing by themselves. Others never go
+// through the recognizer so their presses are not delayed.
+void HandleGestureContact(Button* button, TouchEvent event, int x, int y)
+{
+	Gamepad* gamepad = button->gamepad;
+	int index = (int)(button - gamepad->buttons);
+	Timestamp now = GetTimestamp();
+
+	switch (event)
+	{
+	case TOUCH_DOWN:
+		GestureDown(&gamepad->gestures, index, &button->gestures, x, y, now);
+		break;
+	case TOUCH_MOVE:
+		GestureMove(&gamepad->gestures, index, x, y, now);
+		break;
+	case TOUCH_UP:
+		GestureUp(&gamepad->gestures, index, now);
+		break;
+	}
+}
+
+// Unlike other buttons, keyboards follow every finger
+void HandleKeyboardContact(Button* button, uint32_t id, TouchEvent event, int x, int y)
+{
+	Keyboard* keyboard = &button->extras.keyboard;
+	Output* output = button->gamepad->output;
+
+	if (event == TOUCH_DOWN)
+	{
+		const GridRect* bounds = GetButtonBounds(button);
+		KeyboardDown(
+			keyboard,
+			output,
+			id,
+			(x - bounds->left) / 100,
+			(y - bounds->top) / 100
+		);
+	}
+	else if (event == TOUCH_UP)
+	{
+		KeyboardUp(keyboard, output, id);
+	}
+}
+
+void HandleContact(Button* button, uint32_t id, TouchEvent event, int x, int y)
+{
+	if (button->type == BTN_KEYBOARD)
+	{
+		HandleKeyboardContact(button, id, event, x, y);
+		return;
+	}
+
+	// Other buttons follow one finger at a time
+	if (!RouteContact(&button->capture, id, &event)) { return; }
 
-	if (GetTouchInputInfo((HTOUCHINPUT)lParam, 1, &touch, sizeof(TOUCHINPUT)))
+	if (button->type == BTN_STICK)
+	{
+		const GridRect* bounds = GetButtonBounds(button);
+		int clientX = (x - bounds->left) / 100;
+		int clientY = (y - bounds->top) / 100;
+		HandleStickButton(button, event, clientX, clientY);
+	}
+	else if (button->type == BTN_SLIDER)
+	{
+		HandleSliderButton(button, event, x, y);
+	}
+	else if (button->type == BTN_DIAL)
+	{
+		HandleDialButton(button, event, x, y);
+	}
+	else if (button->type == BTN_TRACKPAD)
+	{
+		// Relative mouse motion moves the cursor itself so trackpads only
+		// respond to touch and not to mouse input
+		HandleTrackpadButton(button, event, x, y);
+	}
+	else if (button->type == BTN_TRACKBALL)
+	{
+		HandleTrackballButton(button, event, x, y);
+	}
+	else if (HasGestures(&button->gestures))
+	{
+		HandleGestureContact(button, event, x, y);
+	}
+	else if (event != TOUCH_MOVE)
 	{
-		if (button->type == BTN_STICK)
+		HandleUpDown(button, event == TOUCH_DOWN);
+	}
+}
+
+// Receives contacts from the tracker on the button they are over
+void DispatchContact(
+	void* userData, int target, uint32_t id, TouchEvent event, int x, int y
+)
+{
+	Gamepad* gamepad = (Gamepad*)userData;
+
+	HandleContact(&gamepad->buttons[target], id, event, x, y);
+}
+
+// Mouse input only acts on the window which received it. Coordinates are in
+// client pixels.
+void HandleMouse(Button* button, TouchEvent event, int x, int y)
+{
+	const GridRect* bounds = GetButtonBounds(button);
+	int screenX = bounds->left + x * 100;
+	int screenY = bounds->top + y * 100;
+
+	if (button->type == BTN_STICK)
+	{
+		HandleStickButton(button, event, x, y);
+	}
+	else if (button->type == BTN_KEYBOARD)
+	{
+		Keyboard* keyboard = &button->extras.keyboard;
+		if (event == TOUCH_DOWN)
 		{
-			TouchEvent event;
-			if (touch.dwFlags & TOUCHEVENTF_DOWN)
-			{
-				event = TOUCH_DOWN;
-			}
-			else if (touch.dwFlags & TOUCHEVENTF_UP)
-			{
-				event = TOUCH_UP;
-			}
-			else
-			{
-				event = TOUCH_MOVE;
-			}
+			KeyboardDown(keyboard, button->gamepad->output, MOUSE_CONTACT_ID, x, y);
+		}
+		else if (event == TOUCH_UP)
+		{
+			KeyboardUp(keyboard, button->gamepad->output, MOUSE_CONTACT_ID);
+		}
+	}
+	else if (button->type == BTN_DIAL)
+	{
+		if (button->extras.dial.mode == DIAL_MOUSE) { return; }
+
+		HandleDialButton(button, event, screenX, screenY);
+	}
+	else if (button->type == BTN_SLIDER)
+	{
+		// Like trackpads, sliders moving the mouse only respond to touch
+		if (button->extras.slider.mode == SLIDER_MOUSE) { return; }
+
+		HandleSliderButton(button, event, screenX, screenY);
+	}
+	else if (HasGestures(&button->gestures))
+	{
+		HandleGestureContact(button, event, screenX, screenY);
+	}
+	else if (event != TOUCH_MOVE)
+	{
+		HandleUpDown(button, event == TOUCH_DOWN);
+	}
+}
+
+void HandleQueuedInputs(Gamepad* gamepad, Timestamp now)
+{
+	InputChannel* channel = gamepad->channel;
+	TouchTracker* tracker = &gamepad->tracker;
+	bool stale = false;
+
+	// Input queued meanwhile waits for the next round, so that the output
+	// of this one is not held back
+	for (int i = 0; i < MAX_QUEUED_INPUTS; ++i)
+	{
+		QueuedInput input;
+		if (!PopRing(&channel->inputs, &input)) { break; }
+		if (input.generation != channel->generation) { continue; }
 
-			int clientX = touch.x / 100 - GetButtonX(button);
-			int clientY = touch.y / 100 - GetButtonY(button);
-			HandleStickButton(button, event, clientX, clientY);
+		const TouchPoint* point = &input.point;
+		channel->handled[channel->numHandled++] = input.received;
+		gamepad->touchTime = point->time;
+
+		if (input.source == SOURCE_MOUSE)
+		{
+			HandleMouse(
+				&gamepad->buttons[input.button], point->event, point->x, point->y
+			);
+			continue;
+		}
+
+		// After a stall, such as a config reload, only the latest position
+		// of each contact is applied once the queue is drained. Mouse moves
+		// need no such care as Windows only ever queues one.
+		bool late = input.late
+			|| (now > input.received && now - input.received > TOUCH_BACKLOG_TIME * 1000);
+		if (late && point->event == TOUCH_MOVE)
+		{
+			stale = true;
+			DeferMove(tracker, point->id, point->x, point->y);
 		}
-		else if (touch.dwFlags & (TOUCHEVENTF_DOWN | TOUCHEVENTF_UP))
+		else
 		{
-			HandleUpDown(button, touch.dwFlags & TOUCHEVENTF_DOWN);
+			TrackContact(tracker, point->id, point->event, point->x, point->y);
 		}
+	}
 
-		CloseTouchInputHandle((HTOUCHINPUT)lParam);
-		return 0;
+	if (stale) { ++tracker->staleBatches; }
+	ApplyDeferredMoves(tracker);
+}
+
+void RecordInjection(InputChannel* channel, Timestamp now)
+{
+	for (int i = 0; i < channel->numHandled; ++i)
+	{
+		RecordLatency(&channel->latency, channel->handled[i], now);
 	}
-	else
+	channel->numHandled = 0;
+}
+
+void SendKnobs(Gamepad* gamepad)
+{
+	InputChannel* channel = gamepad->channel;
+	bool sent = false;
+
+	for (int i = 0; i < gamepad->numButtons && gamepad->movedKnobs; ++i)
+	{
+		uint32_t bit = 1u << i;
+		if (!(gamepad->movedKnobs & bit)) { continue; }
+
+		Button* button = &gamepad->buttons[i];
+		KnobUpdate update;
+		update.button = i;
+		update.knobX = button->extras.stick.knobX;
+		update.knobY = button->extras.stick.knobY;
+		update.generation = channel->generation;
+		// The window thread is behind, the knob is sent again later rather
+		// than waiting for it
+		if (!PushRing(&channel->knobs, &update))
+		{
+			++channel->delayedKnobs;
+			break;
+		}
+
+		gamepad->movedKnobs &= ~bit;
+		sent = true;
+	}
+
+	if (sent) { SetEvent(channel->knobsReady); }
+}
+
+void DrawKnobs(Gamepad* gamepad)
+{
+	InputChannel* channel = gamepad->channel;
+
+	KnobUpdate update;
+	while (PopRing(&channel->knobs, &update))
+	{
+		if (update.generation != channel->generation) { continue; }
+
+		Button* button = &gamepad->buttons[update.button];
+		button->extras.stick.drawX = update.knobX;
+		button->extras.stick.drawY = update.knobY;
+		if (button->window) { InvalidateRect(button->window, NULL, FALSE); }
+	}
+}
+
+// The window thread may wait for the input thread, never the reverse
+void QueueInput(Button* button, QueuedInput* input)
+{
+	InputChannel* channel = button->gamepad->channel;
+
+	input->button = (int)(button - button->gamepad->buttons);
+	input->generation = channel->generation;
+	while (!PushRing(&channel->inputs, input)) { Sleep(0); }
+}
+
+LRESULT CALLBACK OnTouch(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	// Every contact of the batch is queued before the input thread is woken
+	// up to handle them together
+	BUTTON(hWnd, button);
+	HTOUCHINPUT handle = (HTOUCHINPUT)lParam;
+	TouchBuffer* buffer = &button->gamepad->channel->touches;
+	UINT numInputs = (UINT)ReserveTouchBuffer(buffer, LOWORD(wParam));
+	const TOUCHINPUT* touches = (const TOUCHINPUT*)buffer->items;
+
+	if (
+		numInputs == 0
+			|| !GetTouchInputInfo(handle, numInputs, buffer->items, sizeof(TOUCHINPUT))
+	)
 	{
 		return DefWindowProc(hWnd, uMsg, wParam, lParam);
 	}
+
+	QueuedInput input;
+	input.source = SOURCE_TOUCH;
+	DWORD tickCount = GetTickCount();
+	input.late = tickCount - (DWORD)GetMessageTime() > TOUCH_BACKLOG_TIME;
+	input.received = GetTimestamp();
+
+	// Windows sends the contacts to the window they landed on even after
+	// they leave it, so the tracker decides which button they are over
+	for (UINT i = 0; i < numInputs; ++i)
+	{
+		const TOUCHINPUT* touch = &touches[i];
+		TouchPoint* point = &input.point;
+		if (touch->dwFlags & TOUCHEVENTF_DOWN)
+		{
+			point->event = TOUCH_DOWN;
+		}
+		else if (touch->dwFlags & TOUCHEVENTF_UP)
+		{
+			point->event = TOUCH_UP;
+		}
+		else
+		{
+			point->event = TOUCH_MOVE;
+		}
+		point->id = touch->dwID;
+		point->x = touch->x;
+		point->y = touch->y;
+
+		// Move the digitizer's sample time onto the timestamp clock
+		DWORD age = tickCount - touch->dwTime;
+		bool timed = (touch->dwMask & TOUCHINPUTMASKF_TIMEFROMSYSTEM)
+			&& age <= MAX_TOUCH_AGE;
+		point->time = input.received - (timed ? age * 1000ull : 0);
+		QueueInput(button, &input);
+	}
+
+	CloseTouchInputHandle(handle);
+	SetEvent(button->gamepad->channel->inputReady);
+	return 0;
 }
 
 bool IsFakeMouseEvent()
@@ -206,6 +957,21 @@ bool IsFakeMouseEvent()
 	return (GetMessageExtraInfo() & MOUSEEVENTF_FROMTOUCH) == MOUSEEVENTF_FROMTOUCH;
 }
 
+void QueueMouse(Button* button, TouchEvent event, LPARAM lParam)
+{
+	QueuedInput input;
+	input.source = SOURCE_MOUSE;
+	input.point.id = MOUSE_CONTACT_ID;
+	input.point.event = event;
+	input.point.x = GET_X_LPARAM(lParam);
+	input.point.y = GET_Y_LPARAM(lParam);
+	input.received = GetTimestamp();
+	input.point.time = input.received;
+	input.late = false;
+	QueueInput(button, &input);
+	SetEvent(button->gamepad->channel->inputReady);
+}
+
 LRESULT CALLBACK OnMouseButton(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
 	UNUSED(wParam);
@@ -213,17 +979,7 @@ LRESULT CALLBACK OnMouseButton(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	if (IsFakeMouseEvent()) { return 0; }
 
 	BUTTON(hWnd, button);
-	if (button->type == BTN_STICK)
-	{
-		TouchEvent event = uMsg == WM_LBUTTONDOWN ? TOUCH_DOWN : TOUCH_UP;
-		HandleStickButton(
-			button, event, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)
-		);
-	}
-	else
-	{
-		HandleUpDown(button, uMsg == WM_LBUTTONDOWN);
-	}
+	QueueMouse(button, uMsg == WM_LBUTTONDOWN ? TOUCH_DOWN : TOUCH_UP, lParam);
 
 	return 0;
 }
@@ -232,17 +988,54 @@ LRESULT CALLBACK OnMouseMove(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
 	UNUSED(uMsg);
 
-	if (IsFakeMouseEvent()) { return 0; }
+	if (IsFakeMouseEvent() || !(wParam & MK_LBUTTON)) { return 0; }
 
 	BUTTON(hWnd, button);
-	if ((button->type == BTN_STICK) && (wParam & MK_LBUTTON))
+	QueueMouse(button, TOUCH_MOVE, lParam);
+
+	return 0;
+}
+
+// Update everything which depends on where the button is on screen. Right
+// and bottom anchored buttons move when the display resolution changes.
+void PlaceButton(Button* button)
+{
+	Gamepad* gamepad = button->gamepad;
+	int x = GetButtonX(button);
+	int y = GetButtonY(button);
+
+	if (button->type == BTN_WHEEL) { ComputeWheelTarget(button); }
+	if (button->type == BTN_DIAL)
 	{
-		HandleStickButton(
-			button, TOUCH_MOVE, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)
+		// Ignore the inner quarter of the dial's radius
+		int size = button->width < button->height ? button->width : button->height;
+		LayoutDial(
+			&button->extras.dial,
+			(x + button->width / 2) * 100,
+			(y + button->height / 2) * 100,
+			size * 100 / 8
 		);
 	}
 
-	return 0;
+	if (button->window)
+	{
+		SetWindowPos(
+			button->window,
+			NULL,
+			x, y,
+			0, 0,
+			SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE
+		);
+	}
+
+	MoveTrackerTarget(
+		&gamepad->tracker,
+		(int)(button - gamepad->buttons),
+		x * 100,
+		y * 100,
+		button->width * 100,
+		button->height * 100
+	);
 }
 
 LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
@@ -267,6 +1060,17 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		return OnMouseButton(hWnd, uMsg, wParam, lParam);
 	case WM_MOUSEMOVE:
 		return OnMouseMove(hWnd, uMsg, wParam, lParam);
+	case WM_DISPLAYCHANGE:
+		{
+			// Every button window receives this and places itself, while
+			// the input thread is not using the layout
+			BUTTON(hWnd, button);
+			InputChannel* channel = button->gamepad->channel;
+			EnterCriticalSection(&channel->lock);
+			PlaceButton(button);
+			LeaveCriticalSection(&channel->lock);
+			return 0;
+		}
 	default:
 		return DefWindowProc(hWnd, uMsg, wParam, lParam);
 	}
@@ -283,11 +1087,85 @@ void RegisterGamepadWindowClass()
 	RegisterClass(&wc);
 }
 
-void InitializeGamepad(Gamepad* gamepad)
+void InitInputChannel(InputChannel* channel)
+{
+	InitRing(
+		&channel->inputs, channel->inputItems, sizeof(QueuedInput), MAX_QUEUED_INPUTS
+	);
+	InitRing(
+		&channel->knobs, channel->knobItems, sizeof(KnobUpdate), MAX_QUEUED_KNOBS
+	);
+	channel->inputReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	channel->knobsReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	InitializeCriticalSection(&channel->lock);
+	channel->windowThread = GetCurrentThreadId();
+	channel->generation = 0;
+	channel->numHandled = 0;
+	ResetLatency(&channel->latency);
+	channel->delayedKnobs = 0;
+	InitTouchBuffer(&channel->touches, sizeof(TOUCHINPUT));
+	ReserveTouchBuffer(&channel->touches, INITIAL_TOUCH_INPUTS);
+}
+
+void FreeInputChannel(InputChannel* channel)
 {
+	FreeTouchBuffer(&channel->touches);
+	DeleteCriticalSection(&channel->lock);
+	CloseHandle(channel->knobsReady);
+	CloseHandle(channel->inputReady);
+}
+
+// Called from the window thread, with the channel's lock held once the input
+// thread is running
+void InitializeGamepad(
+	Gamepad* gamepad, Scheduler* scheduler, Output* output, InputChannel* channel
+)
+{
+	gamepad->scheduler = scheduler;
+	gamepad->output = output;
+	// Input queued for the previous layout no longer applies
+	gamepad->channel = channel;
+	++channel->generation;
+	gamepad->movedKnobs = 0;
+	InitTypematic(&gamepad->typematic, scheduler, output);
+	gamepad->layerMask = 0;
+	gamepad->activeLayer = 0;
+	StartChords(&gamepad->chords, scheduler, output, &PassChordButton, gamepad);
+	InitTracker(&gamepad->tracker, &DispatchContact, gamepad);
+	StartGestures(&gamepad->gestures, scheduler, output);
+
 	for (int i = 0; i < gamepad->numButtons; ++i)
 	{
 		Button* button = &gamepad->buttons[i];
+		button->gamepad = gamepad;
+		button->capture.active = false;
+
+		if (button->type == BTN_SLIDER)
+		{
+			Slider* slider = &button->extras.slider;
+			LayoutSlider(slider, slider->vertical ? button->height : button->width);
+		}
+		if (button->type == BTN_KEYBOARD) { button->extras.keyboard.numContacts = 0; }
+		// Motion and chord buttons are not touched directly. They still get
+		// an empty target so that target indices are button indices.
+		if (button->type == BTN_MOTION || button->type == BTN_CHORD)
+		{
+			AddTrackerTarget(&gamepad->tracker, 0, 0, 0, 0, 0);
+			continue;
+		}
+
+		// Controls following a finger keep it when dragged past their edge
+		int flags = button->slideIn ? TARGET_SLIDE_IN : 0;
+		if (
+			button->type == BTN_STICK || button->type == BTN_TRACKPAD
+				|| button->type == BTN_SLIDER || button->type == BTN_DIAL
+				|| button->type == BTN_KEYBOARD || button->type == BTN_TRACKBALL
+		)
+		{
+			flags |= TARGET_FOLLOW;
+		}
+		AddTrackerTarget(&gamepad->tracker, 0, 0, 0, 0, flags);
+		PlaceButton(button);
 
 		HWND hwnd = CreateWindowEx(
 			WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_NOACTIVATE, // Ex styles
@@ -317,10 +1195,191 @@ void DeinitializeGamepad(Gamepad* gamepad)
 	{
 		Button* button = &gamepad->buttons[i];
 
+		if (button->type == BTN_MACRO || button->type == BTN_MOTION)
+		{
+			CancelMacro(&button->extras.macro.player);
+		}
+		else if (button->type == BTN_WHEEL)
+		{
+			WheelUp(&button->extras.wheel);
+		}
+		else if (button->type == BTN_STICK)
+		{
+			StopPwm(&button->extras.stick.pwm);
+		}
+		else if (button->type == BTN_TRACKBALL)
+		{
+			StopTrackball(&button->extras.trackball);
+		}
+		else if (button->type == BTN_SLIDER)
+		{
+			StopSlider(&button->extras.slider);
+		}
+		else if (button->type == BTN_DIAL)
+		{
+			StopDial(&button->extras.dial);
+		}
+
 		if (button->window)
 		{
 			DestroyWindow(button->window);
 			button->window = 0;
 		}
 	}
-}
\ No newline at end of file
+
+	// Keys held by destroyed buttons would otherwise never be released
+	if (gamepad->output)
+	{
+		StopChords(&gamepad->chords);
+		StopGestures(&gamepad->gestures);
+		StopAllRepeats(&gamepad->typematic);
+		ReleaseAllKeys(gamepad->output);
+
+		TouchTracker* tracker = &gamepad->tracker;
+		if (tracker->staleBatches)
+		{
+			DebugPrint(
+				"Coalesced %u touch moves in %u late batches",
+				tracker->coalescedMoves,
+				tracker->staleBatches
+			);
+		}
+	}
+}
+
+#ifdef _TEST
+
+#include <string.h>
+#include "utest.h"
+
+// The window thread stops drawing while a floating stick keeps moving: the
+// input thread never waits for it and the latest position is drawn once it
+// catches up
+TEST(knob_stall)
+{
+	static Gamepad gamepad;
+	static InputChannel channel;
+	memset(&gamepad, 0, sizeof(Gamepad));
+	InitInputChannel(&channel);
+	gamepad.channel = &channel;
+	gamepad.numButtons = 2;
+	gamepad.buttons[0].type = BTN_STICK;
+	gamepad.buttons[1].type = BTN_STICK;
+
+	// Fill the ring, then one more position finds it full
+	for (int i = 0; i <= MAX_QUEUED_KNOBS; ++i)
+	{
+		gamepad.buttons[1].extras.stick.knobX = i;
+		gamepad.movedKnobs |= 1u << 1;
+		SendKnobs(&gamepad);
+	}
+	TEST_ASSERT_EQUAL_INT(1, channel.delayedKnobs);
+	TEST_ASSERT(gamepad.movedKnobs == 1u << 1);
+
+	DrawKnobs(&gamepad);
+	TEST_ASSERT_EQUAL_INT(MAX_QUEUED_KNOBS - 1, gamepad.buttons[1].extras.stick.drawX);
+	TEST_ASSERT_EQUAL_INT(0, gamepad.buttons[0].extras.stick.drawX);
+
+	// The position which did not fit is sent once there is room
+	SendKnobs(&gamepad);
+	TEST_ASSERT(gamepad.movedKnobs == 0);
+	DrawKnobs(&gamepad);
+	TEST_ASSERT_EQUAL_INT(MAX_QUEUED_KNOBS, gamepad.buttons[1].extras.stick.drawX);
+
+	// Positions sent for a replaced layout are not drawn
+	gamepad.buttons[1].extras.stick.knobX = -1;
+	gamepad.movedKnobs = 1u << 1;
+	SendKnobs(&gamepad);
+	++channel.generation;
+	DrawKnobs(&gamepad);
+	TEST_ASSERT_EQUAL_INT(MAX_QUEUED_KNOBS, gamepad.buttons[1].extras.stick.drawX);
+
+	FreeInputChannel(&channel);
+}
+
+// Taps keep being injected on time while the knob ring stays full
+TEST(knob_stall_latency)
+{
+	static Gamepad gamepad;
+	static InputChannel channel;
+	static OutputRecorder recorder;
+	Scheduler scheduler;
+	Output output;
+	Timestamp clock = 1000000;
+	const char* error;
+
+	memset(&gamepad, 0, sizeof(Gamepad));
+	InitInputChannel(&channel);
+	InitScheduler(&scheduler);
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	gamepad.channel = &channel;
+	gamepad.scheduler = &scheduler;
+	gamepad.output = &output;
+	gamepad.numButtons = 2;
+	InitTracker(&gamepad.tracker, &DispatchContact, &gamepad);
+
+	Button* keys = &gamepad.buttons[0];
+	keys->type = BTN_KEYBOARD;
+	keys->gamepad = &gamepad;
+	InitKeyboard(&keys->extras.keyboard);
+	keys->extras.keyboard.keyWidth = 100;
+	keys->extras.keyboard.keyHeight = 100;
+	TEST_ASSERT(AddKeyboardRow(&keys->extras.keyboard, "a", &error));
+	AddTrackerTarget(&gamepad.tracker, 0, 0, 10000, 10000, 0);
+
+	Button* stick = &gamepad.buttons[1];
+	stick->type = BTN_STICK;
+	stick->gamepad = &gamepad;
+
+	// The window thread stopped drawing
+	for (int i = 0; i < MAX_QUEUED_KNOBS; ++i)
+	{
+		stick->extras.stick.knobX = i;
+		gamepad.movedKnobs |= 1u << 1;
+		SendKnobs(&gamepad);
+	}
+	TEST_ASSERT_EQUAL_INT(0, channel.delayedKnobs);
+
+	for (int round = 0; round < 4; ++round)
+	{
+		TouchEvent events[] = { TOUCH_DOWN, TOUCH_UP };
+		for (int i = 0; i < 2; ++i)
+		{
+			QueuedInput input;
+			memset(&input, 0, sizeof(input));
+			input.source = SOURCE_TOUCH;
+			input.point.id = 1;
+			input.point.event = events[i];
+			input.point.x = 5000;
+			input.point.y = 5000;
+			input.point.time = clock;
+			input.received = clock;
+			QueueInput(keys, &input);
+		}
+
+		// Handled a millisecond after being received, as the input thread is
+		// not held up by the knobs
+		clock += 1000;
+		HandleQueuedInputs(&gamepad, clock);
+		RunScheduler(&scheduler, clock);
+		FlushOutput(&output);
+		RecordInjection(&channel, clock);
+
+		stick->extras.stick.knobX = MAX_QUEUED_KNOBS + round;
+		gamepad.movedKnobs |= 1u << 1;
+		SendKnobs(&gamepad);
+
+		TEST_ASSERT(channel.latency.max == 1000);
+		clock += 16000;
+	}
+
+	TEST_ASSERT_EQUAL_INT(4, channel.delayedKnobs);
+	TEST_ASSERT_EQUAL_INT(8, (int)channel.latency.count);
+	TEST_ASSERT_EQUAL_INT(8, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT('A', recorder.events[6].event.data.key.code);
+
+	FreeInputChannel(&channel);
+}
+
+#endif
@@ -2,9 +2,95 @@
 #define TOUCH_JOY_GAMEPAD_WINDOW_H
 
 #include "gamepad.h"
+#include "ring.h"
+
+#define MAX_QUEUED_INPUTS 256
+#define MAX_QUEUED_KNOBS 64
+
+typedef enum
+{
+	SOURCE_TOUCH,
+	SOURCE_MOUSE
+} InputSource;
+
+// Touch or mouse input received by a button window
+typedef struct
+{
+	InputSource source;
+	// In client pixels for the mouse, its time is when it was received
+	TouchPoint point;
+	// Window which received the input, the mouse only acts on it
+	int button;
+	// Waited in the message queue long enough to be part of a backlog
+	bool late;
+	// When the window procedure got the input, the point's time is when the
+	// digitizer sampled it
+	Timestamp received;
+	// Layout the input was received with. Input left over from a reloaded
+	// layout is dropped.
+	uint32_t generation;
+} QueuedInput;
+
+// New position of a floating stick's image
+typedef struct
+{
+	int button;
+	int knobX;
+	int knobY;
+	uint32_t generation;
+} KnobUpdate;
+
+// Connects the window thread, which receives input and paints, to the input
+// thread, which handles input and injects output. Painting never delays the
+// input thread: each ring has a single producer and the input thread never
+// waits on the knob ring. The window thread waits for room in the input ring
+// instead of dropping touches, whose releases must not be lost.
+struct InputChannel
+{
+	RingBuffer inputs;
+	QueuedInput inputItems[MAX_QUEUED_INPUTS];
+	RingBuffer knobs;
+	KnobUpdate knobItems[MAX_QUEUED_KNOBS];
+	// Auto reset, set after pushing to the ring of the same name
+	HANDLE inputReady;
+	HANDLE knobsReady;
+	// Held by the input thread while it handles input and by the window
+	// thread while it replaces or moves the layout
+	CRITICAL_SECTION lock;
+	DWORD windowThread;
+	// Only changed by the window thread, with the lock held
+	uint32_t generation;
+	// TOUCHINPUTs of the message being received, used by the window thread
+	TouchBuffer touches;
+	// Receipt times of the inputs handled since the last injection
+	int numHandled;
+	Timestamp handled[MAX_QUEUED_INPUTS];
+	// From input being received to the output it produces being injected
+	LatencyStats latency;
+	// Knob positions not sent because the window thread was behind, sent
+	// again later
+	uint32_t delayedKnobs;
+};
 
 void RegisterGamepadWindowClass();
-void InitializeGamepad(Gamepad* gamepad);
+// Must be called from the window thread
+void InitInputChannel(InputChannel* channel);
+void FreeInputChannel(InputChannel* channel);
+void InitializeGamepad(
+	Gamepad* gamepad, Scheduler* scheduler, Output* output, InputChannel* channel
+);
 void DeinitializeGamepad(Gamepad* gamepad);
+// OutputSink which injects events with SendInput.
+// userData is the Gamepad whose key mode applies.
+void SendInputSink(void* userData, const OutputEvent* events, int numEvents);
+
+// Input thread, with the channel's lock held: handle the queued input,
+// then once the output is flushed record its latency and send the knobs
+// which moved
+void HandleQueuedInputs(Gamepad* gamepad, Timestamp now);
+void RecordInjection(InputChannel* channel, Timestamp now);
+void SendKnobs(Gamepad* gamepad);
+// Window thread: redraw the sticks whose knob moved
+void DrawKnobs(Gamepad* gamepad);
 
-#endif
\ No newline at end of file
+#endif
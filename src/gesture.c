@@ -0,0 +1,459 @@
+#include <stddef.h>
+#include "gesture.h"
+
+static bool IsBound(const GestureBindings* bindings, Gesture gesture)
+{
+	return (bindings->bound & (1u << gesture)) != 0;
+}
+
+static bool HasSwipes(const GestureBindings* bindings)
+{
+	return IsBound(bindings, GESTURE_SWIPE_UP)
+		|| IsBound(bindings, GESTURE_SWIPE_DOWN)
+		|| IsBound(bindings, GESTURE_SWIPE_LEFT)
+		|| IsBound(bindings, GESTURE_SWIPE_RIGHT);
+}
+
+static GestureSlot* FindSlot(GestureRecognizer* recognizer, int button)
+{
+	for (int i = 0; i < MAX_GESTURE_SLOTS; ++i)
+	{
+		GestureSlot* slot = &recognizer->slots[i];
+		if (slot->state != GESTURE_FREE && slot->button == button) { return slot; }
+	}
+
+	return NULL;
+}
+
+// Schedule the shared timer for the earliest deadline of all slots
+static void Reschedule(GestureRecognizer* recognizer)
+{
+	Timestamp due = 0;
+	for (int i = 0; i < MAX_GESTURE_SLOTS; ++i)
+	{
+		const GestureSlot* slot = &recognizer->slots[i];
+		if (slot->state == GESTURE_FREE) { continue; }
+
+		if (slot->deadline && (!due || slot->deadline < due)) { due = slot->deadline; }
+		if (slot->release && (!due || slot->release < due)) { due = slot->release; }
+	}
+
+	if (due)
+	{
+		ScheduleTimer(recognizer->scheduler, &recognizer->timer, due);
+	}
+	else
+	{
+		CancelTimer(recognizer->scheduler, &recognizer->timer);
+	}
+}
+
+static void ReleaseSlotKey(GestureRecognizer* recognizer, GestureSlot* slot)
+{
+	if (!slot->code) { return; }
+
+	OutputKey(recognizer->output, slot->code, false);
+	slot->code = 0;
+	slot->release = 0;
+}
+
+// Press a key for the slot, until the given time or until the finger lifts
+static void PressSlotKey(
+	GestureRecognizer* recognizer, GestureSlot* slot, Gesture gesture,
+	Timestamp release
+)
+{
+	if (!IsBound(slot->bindings, gesture)) { return; }
+
+	ReleaseSlotKey(recognizer, slot);
+	slot->code = slot->bindings->codes[gesture];
+	slot->release = release;
+	OutputKey(recognizer->output, slot->code, true);
+}
+
+// Free slots with nothing left to do
+static void SettleSlot(GestureSlot* slot)
+{
+	if (slot->state == GESTURE_LIFTED && !slot->code) { slot->state = GESTURE_FREE; }
+}
+
+static void OnGestureTimer(Timer* timer, Timestamp now)
+{
+	GestureRecognizer* recognizer = (GestureRecognizer*)timer->userData;
+
+	for (int i = 0; i < MAX_GESTURE_SLOTS; ++i)
+	{
+		GestureSlot* slot = &recognizer->slots[i];
+		if (slot->state == GESTURE_FREE) { continue; }
+
+		if (slot->release && slot->release <= now) { ReleaseSlotKey(recognizer, slot); }
+
+		if (slot->deadline && slot->deadline <= now)
+		{
+			slot->deadline = 0;
+			if (slot->state == GESTURE_PRESSED)
+			{
+				PressSlotKey(recognizer, slot, GESTURE_LONG_PRESS, 0);
+				slot->state = GESTURE_HELD;
+			}
+			else if (slot->state == GESTURE_WAITING)
+			{
+				// No second press came, so it was a single tap after all
+				PressSlotKey(
+					recognizer, slot, GESTURE_TAP, now + KEY_PULSE_LENGTH
+				);
+				slot->state = GESTURE_LIFTED;
+			}
+		}
+
+		SettleSlot(slot);
+	}
+
+	Reschedule(recognizer);
+}
+
+void InitGestureBindings(GestureBindings* bindings)
+{
+	for (int i = 0; i < NUM_GESTURES; ++i) { bindings->codes[i] = 0; }
+	bindings->bound = 0;
+	bindings->longPressTime = DEFAULT_LONG_PRESS_TIME * 1000ull;
+	bindings->doubleTapTime = DEFAULT_DOUBLE_TAP_TIME * 1000ull;
+	bindings->swipeDistance = DEFAULT_SWIPE_DISTANCE * 100;
+}
+
+void BindGesture(GestureBindings* bindings, Gesture gesture, uint16_t code)
+{
+	bindings->codes[gesture] = code;
+	bindings->bound |= 1u << gesture;
+}
+
+bool HasGestures(const GestureBindings* bindings)
+{
+	return bindings->bound != 0;
+}
+
+void StartGestures(
+	GestureRecognizer* recognizer, Scheduler* scheduler, Output* output
+)
+{
+	InitTimer(&recognizer->timer, &OnGestureTimer, recognizer);
+	recognizer->scheduler = scheduler;
+	recognizer->output = output;
+	for (int i = 0; i < MAX_GESTURE_SLOTS; ++i)
+	{
+		recognizer->slots[i].state = GESTURE_FREE;
+	}
+}
+
+void StopGestures(GestureRecognizer* recognizer)
+{
+	if (!recognizer->scheduler) { return; }
+
+	CancelTimer(recognizer->scheduler, &recognizer->timer);
+	for (int i = 0; i < MAX_GESTURE_SLOTS; ++i)
+	{
+		recognizer->slots[i].state = GESTURE_FREE;
+	}
+}
+
+void GestureDown(
+	GestureRecognizer* recognizer,
+	int button,
+	const GestureBindings* bindings,
+	int x,
+	int y,
+	Timestamp now
+)
+{
+	GestureSlot* slot = FindSlot(recognizer, button);
+	if (slot && slot->state == GESTURE_WAITING)
+	{
+		slot->state = GESTURE_SECOND_PRESS;
+		slot->deadline = 0;
+		Reschedule(recognizer);
+		return;
+	}
+
+	// A key still pulsing from the last gesture is kept by the slot
+	for (int i = 0; !slot && i < MAX_GESTURE_SLOTS; ++i)
+	{
+		if (recognizer->slots[i].state == GESTURE_FREE)
+		{
+			slot = &recognizer->slots[i];
+			slot->code = 0;
+			slot->release = 0;
+		}
+	}
+	if (!slot) { return; }
+
+	slot->state = GESTURE_PRESSED;
+	slot->button = button;
+	slot->bindings = bindings;
+	slot->startX = x;
+	slot->startY = y;
+	slot->deadline = IsBound(bindings, GESTURE_LONG_PRESS)
+		? now + bindings->longPressTime
+		: 0;
+	Reschedule(recognizer);
+}
+
+void GestureMove(
+	GestureRecognizer* recognizer, int button, int x, int y, Timestamp now
+)
+{
+	GestureSlot* slot = FindSlot(recognizer, button);
+	if (!slot || slot->state != GESTURE_PRESSED) { return; }
+	if (!HasSwipes(slot->bindings)) { return; }
+
+	long long dx = x - slot->startX;
+	long long dy = y - slot->startY;
+	long long distance = slot->bindings->swipeDistance;
+	if (dx * dx + dy * dy < distance * distance) { return; }
+
+	// The dominant axis decides the direction
+	Gesture swipe;
+	if ((dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy))
+	{
+		swipe = dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT;
+	}
+	else
+	{
+		swipe = dy > 0 ? GESTURE_SWIPE_DOWN : GESTURE_SWIPE_UP;
+	}
+
+	slot->state = GESTURE_SPENT;
+	slot->deadline = 0;
+	PressSlotKey(recognizer, slot, swipe, now + KEY_PULSE_LENGTH);
+	Reschedule(recognizer);
+}
+
+void GestureUp(GestureRecognizer* recognizer, int button, Timestamp now)
+{
+	GestureSlot* slot = FindSlot(recognizer, button);
+	if (!slot) { return; }
+
+	Timestamp pulseEnd = now + KEY_PULSE_LENGTH;
+	switch (slot->state)
+	{
+	case GESTURE_PRESSED:
+		slot->deadline = 0;
+		if (IsBound(slot->bindings, GESTURE_DOUBLE_TAP))
+		{
+			// Whether this is a tap depends on what comes next
+			slot->state = GESTURE_WAITING;
+			slot->deadline = now + slot->bindings->doubleTapTime;
+		}
+		else
+		{
+			PressSlotKey(recognizer, slot, GESTURE_TAP, pulseEnd);
+			slot->state = GESTURE_LIFTED;
+		}
+		break;
+	case GESTURE_SECOND_PRESS:
+		PressSlotKey(recognizer, slot, GESTURE_DOUBLE_TAP, pulseEnd);
+		slot->state = GESTURE_LIFTED;
+		break;
+	case GESTURE_HELD:
+		ReleaseSlotKey(recognizer, slot);
+		slot->state = GESTURE_LIFTED;
+		break;
+	case GESTURE_SPENT:
+		slot->state = GESTURE_LIFTED;
+		break;
+	default:
+		break;
+	}
+
+	SettleSlot(slot);
+	Reschedule(recognizer);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+typedef enum
+{
+	SCRIPT_DOWN,
+	SCRIPT_MOVE,
+	SCRIPT_UP
+} ScriptAction;
+
+// A scripted touch, times in milliseconds and positions in pixels
+typedef struct
+{
+	int time;
+	ScriptAction action;
+	int x;
+	int y;
+} ScriptStep;
+
+typedef struct
+{
+	Timestamp now;
+	Scheduler scheduler;
+	Output output;
+	OutputRecorder recorder;
+	GestureRecognizer recognizer;
+	GestureBindings bindings;
+} GestureFixture;
+
+static void InitFixture(GestureFixture* fixture)
+{
+	fixture->now = 0;
+	InitScheduler(&fixture->scheduler);
+	InitOutputRecorder(&fixture->recorder, &fixture->now);
+	InitOutput(&fixture->output, &RecordOutput, &fixture->recorder);
+	StartGestures(&fixture->recognizer, &fixture->scheduler, &fixture->output);
+	InitGestureBindings(&fixture->bindings);
+}
+
+// Run timers due up to a time, one millisecond at a time so that every
+// output is stamped with the millisecond it happened in
+static void RunUntil(GestureFixture* fixture, Timestamp time)
+{
+	while (fixture->now < time)
+	{
+		fixture->now += 1000;
+		RunScheduler(&fixture->scheduler, fixture->now);
+		FlushOutput(&fixture->output);
+	}
+}
+
+// Replay touches on button 0 and keep running for a second after the last
+static void Replay(GestureFixture* fixture, const ScriptStep* steps, int numSteps)
+{
+	for (int i = 0; i < numSteps; ++i)
+	{
+		const ScriptStep* step = &steps[i];
+		RunUntil(fixture, step->time * 1000ull);
+
+		int x = step->x * 100;
+		int y = step->y * 100;
+		switch (step->action)
+		{
+		case SCRIPT_DOWN:
+			GestureDown(
+				&fixture->recognizer, 0, &fixture->bindings, x, y, fixture->now
+			);
+			break;
+		case SCRIPT_MOVE:
+			GestureMove(&fixture->recognizer, 0, x, y, fixture->now);
+			break;
+		case SCRIPT_UP:
+			GestureUp(&fixture->recognizer, 0, fixture->now);
+			break;
+		}
+		FlushOutput(&fixture->output);
+	}
+
+	RunUntil(fixture, fixture->now + 1000000);
+}
+
+static void AssertKey(
+	const GestureFixture* fixture, int index, uint16_t code, bool down, int time
+)
+{
+	const RecordedOutput* record = &fixture->recorder.events[index];
+	TEST_ASSERT_EQUAL_INT(OUTPUT_KEY, record->event.type);
+	TEST_ASSERT_EQUAL_INT(code, record->event.data.key.code);
+	TEST_ASSERT_EQUAL_INT(down, record->event.data.key.down);
+	TEST_ASSERT_EQUAL_INT(time * 1000, (int)record->time);
+}
+
+TEST(gesture_timing)
+{
+	GestureFixture fixture;
+	const int pulse = KEY_PULSE_LENGTH / 1000;
+
+	// A tap is output on release when nothing else can follow
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	ScriptStep tap[] = {
+		{ 0, SCRIPT_DOWN, 10, 10 },
+		{ 80, SCRIPT_UP, 10, 10 }
+	};
+	Replay(&fixture, tap, 2);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'T', true, 80);
+	AssertKey(&fixture, 1, 'T', false, 80 + pulse);
+	TEST_ASSERT_EQUAL_INT(0, fixture.scheduler.numTimers);
+
+	// With a double tap bound, a tap waits for the end of the window
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_DOUBLE_TAP, 'D');
+	Replay(&fixture, tap, 2);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'T', true, 80 + DEFAULT_DOUBLE_TAP_TIME);
+
+	// A second press just inside the window is a double tap, just outside
+	// it is a tap followed by another one
+	ScriptStep doubleTap[] = {
+		{ 0, SCRIPT_DOWN, 10, 10 },
+		{ 50, SCRIPT_UP, 10, 10 },
+		{ 50 + DEFAULT_DOUBLE_TAP_TIME - 1, SCRIPT_DOWN, 12, 10 },
+		{ 350, SCRIPT_UP, 12, 10 }
+	};
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_DOUBLE_TAP, 'D');
+	Replay(&fixture, doubleTap, 4);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'D', true, 350);
+	AssertKey(&fixture, 1, 'D', false, 350 + pulse);
+
+	doubleTap[2].time = 50 + DEFAULT_DOUBLE_TAP_TIME;
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_DOUBLE_TAP, 'D');
+	Replay(&fixture, doubleTap, 4);
+	TEST_ASSERT_EQUAL_INT(4, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'T', true, 50 + DEFAULT_DOUBLE_TAP_TIME);
+	AssertKey(&fixture, 2, 'T', true, 350 + DEFAULT_DOUBLE_TAP_TIME);
+
+	// A long press is held from the threshold until the finger lifts, a
+	// release just before it is a tap
+	ScriptStep longPress[] = {
+		{ 0, SCRIPT_DOWN, 10, 10 },
+		{ 900, SCRIPT_UP, 10, 10 }
+	};
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_LONG_PRESS, 'L');
+	Replay(&fixture, longPress, 2);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'L', true, DEFAULT_LONG_PRESS_TIME);
+	AssertKey(&fixture, 1, 'L', false, 900);
+
+	longPress[1].time = DEFAULT_LONG_PRESS_TIME - 1;
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_LONG_PRESS, 'L');
+	Replay(&fixture, longPress, 2);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'T', true, DEFAULT_LONG_PRESS_TIME - 1);
+
+	// A swipe fires once the finger has gone far enough, along the dominant
+	// axis, and cancels the tap and long press
+	ScriptStep swipe[] = {
+		{ 0, SCRIPT_DOWN, 100, 100 },
+		{ 20, SCRIPT_MOVE, 110, 80 },
+		{ 40, SCRIPT_MOVE, 115, 100 - DEFAULT_SWIPE_DISTANCE },
+		{ 60, SCRIPT_MOVE, 115, 20 },
+		{ 700, SCRIPT_UP, 115, 20 }
+	};
+	InitFixture(&fixture);
+	BindGesture(&fixture.bindings, GESTURE_TAP, 'T');
+	BindGesture(&fixture.bindings, GESTURE_LONG_PRESS, 'L');
+	BindGesture(&fixture.bindings, GESTURE_SWIPE_UP, 'U');
+	BindGesture(&fixture.bindings, GESTURE_SWIPE_RIGHT, 'R');
+	Replay(&fixture, swipe, 5);
+	TEST_ASSERT_EQUAL_INT(2, fixture.recorder.numEvents);
+	AssertKey(&fixture, 0, 'U', true, 40);
+	AssertKey(&fixture, 1, 'U', false, 40 + pulse);
+	TEST_ASSERT_EQUAL_INT(0, fixture.scheduler.numTimers);
+	TEST_ASSERT_EQUAL_INT(GESTURE_FREE, fixture.recognizer.slots[0].state);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef TOUCH_JOY_GESTURE_H
+#define TOUCH_JOY_GESTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+#define MAX_GESTURE_SLOTS 16
+// Milliseconds
+#define DEFAULT_LONG_PRESS_TIME 500
+#define DEFAULT_DOUBLE_TAP_TIME 250
+// Pixels
+#define DEFAULT_SWIPE_DISTANCE 40
+
+typedef enum
+{
+	GESTURE_TAP,
+	GESTURE_DOUBLE_TAP,
+	// Held until the finger lifts
+	GESTURE_LONG_PRESS,
+	GESTURE_SWIPE_UP,
+	GESTURE_SWIPE_DOWN,
+	GESTURE_SWIPE_LEFT,
+	GESTURE_SWIPE_RIGHT,
+	NUM_GESTURES
+} Gesture;
+
+// Key codes a button outputs for each gesture
+typedef struct
+{
+	uint16_t codes[NUM_GESTURES];
+	// Bit i is set when gesture i is bound
+	uint32_t bound;
+	Timestamp longPressTime;
+	// Longest time between the first release and the second press
+	Timestamp doubleTapTime;
+	// Hundredths of a pixel
+	int swipeDistance;
+} GestureBindings;
+
+typedef enum
+{
+	GESTURE_FREE,
+	GESTURE_PRESSED,
+	// Released once, a second press makes a double tap
+	GESTURE_WAITING,
+	GESTURE_SECOND_PRESS,
+	// The long press key is held
+	GESTURE_HELD,
+	// Swiped, nothing else happens until the finger lifts
+	GESTURE_SPENT,
+	// Lifted, the key of the gesture may still be pulsing
+	GESTURE_LIFTED
+} GestureState;
+
+// State machine of the contact on one button
+typedef struct
+{
+	GestureState state;
+	int button;
+	const GestureBindings* bindings;
+	int startX;
+	int startY;
+	// Long press or end of the double tap window, 0 when not waiting
+	Timestamp deadline;
+	// Key held by the slot and when to release it, 0 to hold it until the
+	// finger lifts
+	uint16_t code;
+	Timestamp release;
+} GestureSlot;
+
+// Recognizes gestures on every button with a single timer for the earliest
+// deadline of all contacts.
+typedef struct
+{
+	GestureSlot slots[MAX_GESTURE_SLOTS];
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+} GestureRecognizer;
+
+void InitGestureBindings(GestureBindings* bindings);
+void BindGesture(GestureBindings* bindings, Gesture gesture, uint16_t code);
+bool HasGestures(const GestureBindings* bindings);
+
+// Reset recognition state, must be called before any event
+void StartGestures(
+	GestureRecognizer* recognizer, Scheduler* scheduler, Output* output
+);
+// Drop every contact and stop the timer. Held keys are left to the caller to
+// release.
+void StopGestures(GestureRecognizer* recognizer);
+void GestureDown(
+	GestureRecognizer* recognizer,
+	int button,
+	const GestureBindings* bindings,
+	int x,
+	int y,
+	Timestamp now
+);
+void GestureMove(
+	GestureRecognizer* recognizer, int button, int x, int y, Timestamp now
+);
+void GestureUp(GestureRecognizer* recognizer, int button, Timestamp now);
+
+#endif
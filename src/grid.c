@@ -0,0 +1,355 @@
+#include "grid.h"
+
+#define MAX_GRID_SHIFT 30
+
+static bool IsEmpty(const GridRect* rect)
+{
+	return rect->right <= rect->left || rect->bottom <= rect->top;
+}
+
+void InitGrid(
+	GridIndex* grid, int* cellStarts, int maxCells, int* items, int maxItems
+)
+{
+	grid->rects = 0;
+	grid->left = 0;
+	grid->top = 0;
+	grid->shift = 0;
+	grid->columns = 0;
+	grid->rows = 0;
+	grid->cellStarts = cellStarts;
+	grid->maxCells = maxCells;
+	grid->items = items;
+	grid->maxItems = maxItems;
+}
+
+// Count the cell entries of every rectangle with cells of a given size, or
+// return -1 if there would be too many cells or entries
+static int CountItems(
+	GridIndex* grid, const GridRect* rects, int numRects, const GridRect* bounds,
+	int shift
+)
+{
+	long long columns = ((long long)(bounds->right - 1 - bounds->left) >> shift) + 1;
+	long long rows = ((long long)(bounds->bottom - 1 - bounds->top) >> shift) + 1;
+	if (columns * rows > grid->maxCells) { return -1; }
+
+	long long numItems = 0;
+	for (int i = 0; i < numRects; ++i)
+	{
+		const GridRect* rect = &rects[i];
+		if (IsEmpty(rect)) { continue; }
+
+		int width = ((rect->right - 1 - bounds->left) >> shift)
+			- ((rect->left - bounds->left) >> shift) + 1;
+		int height = ((rect->bottom - 1 - bounds->top) >> shift)
+			- ((rect->top - bounds->top) >> shift) + 1;
+		numItems += (long long)width * height;
+		if (numItems > grid->maxItems) { return -1; }
+	}
+
+	grid->columns = (int)columns;
+	grid->rows = (int)rows;
+	return (int)numItems;
+}
+
+bool BuildGrid(GridIndex* grid, const GridRect* rects, int numRects)
+{
+	grid->rects = rects;
+	grid->columns = 0;
+	grid->rows = 0;
+
+	GridRect bounds;
+	long long totalSize = 0;
+	int numIndexed = 0;
+	for (int i = 0; i < numRects; ++i)
+	{
+		const GridRect* rect = &rects[i];
+		if (IsEmpty(rect)) { continue; }
+
+		if (numIndexed == 0 || rect->left < bounds.left) { bounds.left = rect->left; }
+		if (numIndexed == 0 || rect->top < bounds.top) { bounds.top = rect->top; }
+		if (numIndexed == 0 || rect->right > bounds.right) { bounds.right = rect->right; }
+		if (numIndexed == 0 || rect->bottom > bounds.bottom) { bounds.bottom = rect->bottom; }
+
+		totalSize += (rect->right - rect->left) + (rect->bottom - rect->top);
+		++numIndexed;
+	}
+
+	// Nothing can be hit
+	if (numIndexed == 0) { return true; }
+
+	// Start with cells about the size of an average rectangle so that each
+	// one only overlaps a few
+	long long averageSize = totalSize / (numIndexed * 2);
+	int shift = 0;
+	while (shift < MAX_GRID_SHIFT && (1ll << (shift + 1)) <= averageSize) { ++shift; }
+
+	int numItems;
+	while ((numItems = CountItems(grid, rects, numRects, &bounds, shift)) < 0)
+	{
+		if (++shift > MAX_GRID_SHIFT) { return false; }
+	}
+
+	grid->left = bounds.left;
+	grid->top = bounds.top;
+	grid->shift = shift;
+
+	int numCells = grid->columns * grid->rows;
+	int* cellStarts = grid->cellStarts;
+	for (int i = 0; i <= numCells; ++i) { cellStarts[i] = 0; }
+
+	// Count the entries of each cell, then turn the counts into the end of
+	// each cell's range
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < numRects; ++i)
+		{
+			const GridRect* rect = &rects[i];
+			if (IsEmpty(rect)) { continue; }
+
+			int firstColumn = (rect->left - grid->left) >> shift;
+			int lastColumn = (rect->right - 1 - grid->left) >> shift;
+			int firstRow = (rect->top - grid->top) >> shift;
+			int lastRow = (rect->bottom - 1 - grid->top) >> shift;
+			for (int row = firstRow; row <= lastRow; ++row)
+			{
+				for (int column = firstColumn; column <= lastColumn; ++column)
+				{
+					int cell = row * grid->columns + column;
+					if (pass == 0)
+					{
+						++cellStarts[cell];
+					}
+					else
+					{
+						// Filling each range backward puts later rectangles,
+						// which are on top, first
+						grid->items[--cellStarts[cell]] = i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0)
+		{
+			for (int i = 1; i <= numCells; ++i) { cellStarts[i] += cellStarts[i - 1]; }
+		}
+	}
+
+	return true;
+}
+
+int QueryGrid(const GridIndex* grid, int x, int y)
+{
+	if (x < grid->left || y < grid->top) { return -1; }
+
+	int column = (x - grid->left) >> grid->shift;
+	int row = (y - grid->top) >> grid->shift;
+	if (column >= grid->columns || row >= grid->rows) { return -1; }
+
+	int cell = row * grid->columns + column;
+	for (int i = grid->cellStarts[cell]; i < grid->cellStarts[cell + 1]; ++i)
+	{
+		int index = grid->items[i];
+		const GridRect* rect = &grid->rects[index];
+		if (x >= rect->left && x < rect->right && y >= rect->top && y < rect->bottom)
+		{
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+#ifdef _TEST
+
+#include <time.h>
+#include "utest.h"
+#include "utils.h"
+
+// Storage for layouts of up to BENCHMARK_RECTS controls
+#define BENCHMARK_RECTS 10000
+#define BENCHMARK_CELLS 65536
+#define BENCHMARK_ITEMS 262144
+
+static int BruteForceQuery(const GridRect* rects, int numRects, int x, int y)
+{
+	for (int i = numRects - 1; i >= 0; --i)
+	{
+		const GridRect* rect = &rects[i];
+		if (x >= rect->left && x < rect->right && y >= rect->top && y < rect->bottom)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static unsigned int NextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+static int RandomBelow(unsigned int* seed, int limit)
+{
+	unsigned int high = NextRandom(seed);
+	unsigned int low = NextRandom(seed);
+	return (int)((high << 15 | low) % (unsigned int)limit);
+}
+
+// Lay out controls on a square grid with a 96 pixel pitch and sizes from 48
+// to 111 pixels so that some of them overlap, in hundredths of a pixel
+static void LayoutControls(GridRect* rects, int numRects, unsigned int* seed)
+{
+	int side = 1;
+	while (side * side < numRects) { ++side; }
+
+	for (int i = 0; i < numRects; ++i)
+	{
+		GridRect* rect = &rects[i];
+		rect->left = (i % side) * 9600 + RandomBelow(seed, 1000);
+		rect->top = (i / side) * 9600 + RandomBelow(seed, 1000);
+		rect->right = rect->left + 4800 + RandomBelow(seed, 6400);
+		rect->bottom = rect->top + 4800 + RandomBelow(seed, 6400);
+	}
+}
+
+TEST(grid_query)
+{
+	static GridRect rects[1000];
+	static int cellStarts[1025];
+	static int items[4096];
+	GridIndex grid;
+	InitGrid(&grid, cellStarts, 1024, items, 4096);
+
+	// Nothing indexed
+	TEST_ASSERT(BuildGrid(&grid, rects, 0));
+	TEST_ASSERT_EQUAL_INT(-1, QueryGrid(&grid, 0, 0));
+
+	// A large rectangle under a small one, an empty one, one far away with a
+	// negative origin and one more
+	const GridRect layout[] = {
+		{ 0, 0, 1000, 1000 },
+		{ 100, 100, 200, 200 },
+		{ 150, 150, 150, 300 },
+		{ -5000, -5000, -4990, -4990 },
+		{ 2000, 2000, 2010, 2010 }
+	};
+	TEST_ASSERT(BuildGrid(&grid, layout, 4));
+	TEST_ASSERT_EQUAL_INT(1, QueryGrid(&grid, 150, 150));
+	TEST_ASSERT_EQUAL_INT(0, QueryGrid(&grid, 200, 150));
+	TEST_ASSERT_EQUAL_INT(0, QueryGrid(&grid, 999, 999));
+	TEST_ASSERT_EQUAL_INT(-1, QueryGrid(&grid, 1000, 999));
+	TEST_ASSERT_EQUAL_INT(3, QueryGrid(&grid, -4995, -4995));
+	TEST_ASSERT_EQUAL_INT(-1, QueryGrid(&grid, -4995, 0));
+	TEST_ASSERT_EQUAL_INT(-1, QueryGrid(&grid, -6000, 0));
+
+	// Too little storage for fine cells makes them coarser, down to a single
+	// cell which needs an entry per non-empty rectangle
+	GridIndex small;
+	static int smallStarts[2];
+	static int smallItems[3];
+	InitGrid(&small, smallStarts, 1, smallItems, 3);
+	TEST_ASSERT(BuildGrid(&small, layout, 4));
+	TEST_ASSERT_EQUAL_INT(1, QueryGrid(&small, 150, 150));
+	TEST_ASSERT_EQUAL_INT(3, QueryGrid(&small, -4995, -4995));
+	TEST_ASSERT(!BuildGrid(&small, layout, 5));
+
+	// Random layouts agree with a scan of every rectangle
+	unsigned int seed = 1;
+	LayoutControls(rects, 1000, &seed);
+	TEST_ASSERT(BuildGrid(&grid, rects, 1000));
+	for (int i = 0; i < 100000; ++i)
+	{
+		int x = RandomBelow(&seed, 320000) - 10000;
+		int y = RandomBelow(&seed, 320000) - 10000;
+		TEST_ASSERT_EQUAL_INT(
+			BruteForceQuery(rects, 1000, x, y), QueryGrid(&grid, x, y)
+		);
+	}
+}
+
+static GridRect denseRects[BENCHMARK_RECTS];
+static int denseCellStarts[BENCHMARK_CELLS + 1];
+static int denseItems[BENCHMARK_ITEMS];
+static int densePoints[2 * 4096];
+
+// Index a layout of numRects controls and pick touches anywhere on it.
+// Return the average number of rectangles in the cells touched.
+static double LayoutDenseGrid(GridIndex* grid, int numRects)
+{
+	unsigned int seed = 42;
+	InitGrid(grid, denseCellStarts, BENCHMARK_CELLS, denseItems, BENCHMARK_ITEMS);
+	LayoutControls(denseRects, numRects, &seed);
+	if (!BuildGrid(grid, denseRects, numRects)) { return -1.0; }
+
+	int width = grid->columns << grid->shift;
+	int height = grid->rows << grid->shift;
+	long long candidates = 0;
+	for (int i = 0; i < 4096; ++i)
+	{
+		int x = grid->left + RandomBelow(&seed, width);
+		int y = grid->top + RandomBelow(&seed, height);
+		densePoints[i * 2] = x;
+		densePoints[i * 2 + 1] = y;
+
+		int cell = ((y - grid->top) >> grid->shift) * grid->columns
+			+ ((x - grid->left) >> grid->shift);
+		candidates += denseCellStarts[cell + 1] - denseCellStarts[cell];
+	}
+
+	return (double)candidates / 4096.0;
+}
+
+// The work per query does not grow with the number of controls
+TEST(grid_density)
+{
+	const int counts[] = { 10, 100, 1000, 10000 };
+	for (int c = 0; c < 4; ++c)
+	{
+		GridIndex grid;
+		double averageCandidates = LayoutDenseGrid(&grid, counts[c]);
+		TEST_ASSERT(averageCandidates >= 0.0 && averageCandidates < 4.0);
+	}
+}
+
+#ifdef _BENCHMARK
+
+TEST(grid_benchmark)
+{
+	const int counts[] = { 10, 100, 1000, 10000 };
+	const int iterations = 4000000;
+
+	for (int c = 0; c < 4; ++c)
+	{
+		GridIndex grid;
+		double averageCandidates = LayoutDenseGrid(&grid, counts[c]);
+		TEST_ASSERT(averageCandidates >= 0.0);
+
+		int hits = 0;
+		clock_t start = clock();
+		for (int i = 0; i < iterations; ++i)
+		{
+			int point = (i & 4095) * 2;
+			hits += QueryGrid(&grid, densePoints[point], densePoints[point + 1]) >= 0;
+		}
+		clock_t end = clock();
+		TEST_ASSERT(hits > 0);
+
+		double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+		ReportBenchmark(
+			"grid_benchmark",
+			"%d controls, %.2f ns per query, %.2f candidates",
+			counts[c],
+			seconds * 1e9 / iterations,
+			averageCandidates
+		);
+	}
+}
+
+#endif
+
+#endif
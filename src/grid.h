@@ -0,0 +1,46 @@
+#ifndef TOUCH_JOY_GRID_H
+#define TOUCH_JOY_GRID_H
+
+#include <stdbool.h>
+
+// Right and bottom edges are excluded. An empty rectangle is never hit.
+typedef struct
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+} GridRect;
+
+// Uniform grid over a set of rectangles, answering which one is on top at a
+// point by looking at the few rectangles overlapping the point's cell.
+// Storage is provided by the owner so the index can be sized for it.
+typedef struct
+{
+	const GridRect* rects;
+	int left;
+	int top;
+	// Cells are 2^shift units wide and high
+	int shift;
+	int columns;
+	int rows;
+	// Rectangles overlapping cell i, topmost first, are
+	// items[cellStarts[i]] up to items[cellStarts[i + 1]]
+	int* cellStarts;
+	int maxCells;
+	int* items;
+	int maxItems;
+} GridIndex;
+
+// cellStarts holds maxCells + 1 entries
+void InitGrid(
+	GridIndex* grid, int* cellStarts, int maxCells, int* items, int maxItems
+);
+// Index rectangles, later ones being on top of earlier ones. They are not
+// copied and must stay alive until the next build. Cells are made coarser
+// until the index fits, which always succeeds if maxItems >= numRects.
+bool BuildGrid(GridIndex* grid, const GridRect* rects, int numRects);
+// Index of the topmost rectangle containing a point or -1
+int QueryGrid(const GridIndex* grid, int x, int y);
+
+#endif
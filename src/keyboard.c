@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#include "keyboard.h"
+#include "keys.h"
+#include "utils.h"
+
+void InitKeyboard(Keyboard* keyboard)
+{
+	memset(keyboard, 0, sizeof(Keyboard));
+	keyboard->keyWidth = 60;
+	keyboard->keyHeight = 60;
+}
+
+// Parse the optional ":1.5" after a key, in quarters of a key
+static bool ParseKeyWidth(const char* start, const char* end, int* width)
+{
+	if (start == end)
+	{
+		*width = KEYBOARD_SUBDIVISIONS;
+		return true;
+	}
+
+	if (*start != ':') { return false; }
+
+	char* numberEnd;
+	double keys = strtod(start + 1, &numberEnd);
+	if (numberEnd != end || keys <= 0.0) { return false; }
+
+	*width = (int)(keys * KEYBOARD_SUBDIVISIONS + 0.5);
+	return *width > 0;
+}
+
+bool AddKeyboardRow(Keyboard* keyboard, const char* source, const char** error)
+{
+	if (keyboard->numRows == MAX_KEYBOARD_ROWS)
+	{
+		*error = "Too many keyboard rows, at most " TO_STRING(MAX_KEYBOARD_ROWS);
+		return false;
+	}
+
+	KeyboardRow* row = &keyboard->rows[keyboard->numRows];
+	memset(row, 0, sizeof(KeyboardRow));
+	memset(row->lookup, NO_KEY, sizeof(row->lookup));
+
+	const char* cursor = source;
+	for (;;)
+	{
+		while (*cursor == ' ' || *cursor == '\t') { ++cursor; }
+		if (*cursor == 0) { break; }
+
+		const char* end = cursor;
+		while (*end && *end != ' ' && *end != '\t') { ++end; }
+
+		// The width suffix starts at the last colon so that ":" could still
+		// be a key name
+		const char* nameEnd = end;
+		while (nameEnd > cursor + 1 && nameEnd[-1] != ':') { --nameEnd; }
+		if (nameEnd == cursor + 1) { nameEnd = end; } else { --nameEnd; }
+
+		int width;
+		if (!ParseKeyWidth(nameEnd, end, &width))
+		{
+			*error = "Invalid key width";
+			return false;
+		}
+
+		if (row->length + width > MAX_ROW_LENGTH)
+		{
+			*error = "Keyboard row is too long";
+			return false;
+		}
+
+		bool isGap = nameEnd - cursor == 1 && *cursor == '_';
+		if (!isGap)
+		{
+			uint16_t code;
+			if (!ParseKeyCode(cursor, nameEnd - cursor, &code))
+			{
+				*error = "Invalid key name";
+				return false;
+			}
+
+			if (row->numKeys == MAX_ROW_KEYS)
+			{
+				*error = "Too many keys in row, at most " TO_STRING(MAX_ROW_KEYS);
+				return false;
+			}
+
+			int key = row->numKeys++;
+			row->codes[key] = code;
+			row->starts[key] = (uint8_t)row->length;
+			row->widths[key] = (uint8_t)width;
+			memset(&row->lookup[row->length], key, width);
+		}
+
+		row->length += width;
+		cursor = end;
+	}
+
+	if (row->numKeys == 0)
+	{
+		*error = "Empty keyboard row";
+		return false;
+	}
+
+	++keyboard->numRows;
+	return true;
+}
+
+int GetKeyboardWidth(const Keyboard* keyboard)
+{
+	int length = 0;
+	for (int i = 0; i < keyboard->numRows; ++i)
+	{
+		if (keyboard->rows[i].length > length) { length = keyboard->rows[i].length; }
+	}
+
+	return length * keyboard->keyWidth / KEYBOARD_SUBDIVISIONS;
+}
+
+int GetKeyboardHeight(const Keyboard* keyboard)
+{
+	return keyboard->numRows * keyboard->keyHeight;
+}
+
+uint16_t HitTestKeyboard(const Keyboard* keyboard, int x, int y)
+{
+	if (x < 0 || y < 0) { return 0; }
+
+	int rowIndex = y / keyboard->keyHeight;
+	if (rowIndex >= keyboard->numRows) { return 0; }
+
+	const KeyboardRow* row = &keyboard->rows[rowIndex];
+	int column = x * KEYBOARD_SUBDIVISIONS / keyboard->keyWidth;
+	if (column >= row->length) { return 0; }
+
+	uint8_t key = row->lookup[column];
+	return key == NO_KEY ? 0 : row->codes[key];
+}
+
+void KeyboardDown(Keyboard* keyboard, Output* output, uint32_t id, int x, int y)
+{
+	// A contact can only hold one key
+	KeyboardUp(keyboard, output, id);
+
+	uint16_t code = HitTestKeyboard(keyboard, x, y);
+	if (code == 0 || keyboard->numContacts == MAX_KEYBOARD_CONTACTS) { return; }
+
+	KeyboardContact* contact = &keyboard->contacts[keyboard->numContacts++];
+	contact->id = id;
+	contact->code = code;
+	OutputKey(output, code, true);
+}
+
+void KeyboardUp(Keyboard* keyboard, Output* output, uint32_t id)
+{
+	for (int i = 0; i < keyboard->numContacts; ++i)
+	{
+		if (keyboard->contacts[i].id != id) { continue; }
+
+		OutputKey(output, keyboard->contacts[i].code, false);
+		keyboard->contacts[i] = keyboard->contacts[--keyboard->numContacts];
+		return;
+	}
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(keyboard_grid)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Output output;
+	Keyboard keyboard;
+	const char* error;
+
+	InitKeyboard(&keyboard);
+	keyboard.keyWidth = 40;
+	keyboard.keyHeight = 50;
+	TEST_ASSERT(AddKeyboardRow(&keyboard, "esc _:0.5 f1 f2", &error));
+	TEST_ASSERT(AddKeyboardRow(&keyboard, "tab:1.5 q w e", &error));
+	TEST_ASSERT(AddKeyboardRow(&keyboard, "shift:2.25  z  ;:0.75", &error));
+	TEST_ASSERT_EQUAL_INT(3, keyboard.numRows);
+	TEST_ASSERT_EQUAL_INT(180, GetKeyboardWidth(&keyboard));
+	TEST_ASSERT_EQUAL_INT(150, GetKeyboardHeight(&keyboard));
+
+	TEST_ASSERT_EQUAL_INT(0x1B, HitTestKeyboard(&keyboard, 0, 0));
+	TEST_ASSERT_EQUAL_INT(0x1B, HitTestKeyboard(&keyboard, 39, 49));
+	// Gap
+	TEST_ASSERT_EQUAL_INT(0, HitTestKeyboard(&keyboard, 45, 10));
+	TEST_ASSERT_EQUAL_INT(0x70, HitTestKeyboard(&keyboard, 60, 10));
+	TEST_ASSERT_EQUAL_INT(0x09, HitTestKeyboard(&keyboard, 59, 60));
+	TEST_ASSERT_EQUAL_INT('Q', HitTestKeyboard(&keyboard, 60, 60));
+	TEST_ASSERT_EQUAL_INT(0x10, HitTestKeyboard(&keyboard, 89, 100));
+	TEST_ASSERT_EQUAL_INT('Z', HitTestKeyboard(&keyboard, 90, 100));
+	TEST_ASSERT_EQUAL_INT(0xBA, HitTestKeyboard(&keyboard, 130, 100));
+	// Past the end of a row and of the grid
+	TEST_ASSERT_EQUAL_INT(0, HitTestKeyboard(&keyboard, 165, 100));
+	TEST_ASSERT_EQUAL_INT(0, HitTestKeyboard(&keyboard, 10, 150));
+	TEST_ASSERT_EQUAL_INT(0, HitTestKeyboard(&keyboard, -1, 10));
+
+	TEST_ASSERT(!AddKeyboardRow(&keyboard, "a:0", &error));
+	TEST_ASSERT(!AddKeyboardRow(&keyboard, "foo", &error));
+	TEST_ASSERT(!AddKeyboardRow(&keyboard, " _ ", &error));
+
+	// The largest keyboard, every key is found
+	Keyboard large;
+	InitKeyboard(&large);
+	large.keyWidth = 10;
+	large.keyHeight = 10;
+	char fullRow[MAX_ROW_KEYS * 2 + 3];
+	for (int i = 0; i < MAX_ROW_KEYS; ++i)
+	{
+		fullRow[i * 2] = (char)('A' + i % 26);
+		fullRow[i * 2 + 1] = ' ';
+	}
+	fullRow[MAX_ROW_KEYS * 2] = 0;
+	for (int i = 0; i < MAX_KEYBOARD_ROWS; ++i)
+	{
+		TEST_ASSERT(AddKeyboardRow(&large, fullRow, &error));
+	}
+	for (int i = 0; i < MAX_KEYBOARD_ROWS * MAX_ROW_KEYS; ++i)
+	{
+		int column = i % MAX_ROW_KEYS;
+		int x = column * 10 + 5;
+		int y = i / MAX_ROW_KEYS * 10 + 5;
+		TEST_ASSERT_EQUAL_INT('A' + column % 26, HitTestKeyboard(&large, x, y));
+	}
+	TEST_ASSERT(!AddKeyboardRow(&large, "a", &error));
+	large.numRows = 0;
+	fullRow[MAX_ROW_KEYS * 2] = 'a';
+	fullRow[MAX_ROW_KEYS * 2 + 1] = 0;
+	TEST_ASSERT(!AddKeyboardRow(&large, fullRow, &error));
+
+	// Several fingers typing at once, including two on the same key
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	KeyboardDown(&keyboard, &output, 1, 100, 100); // z
+	KeyboardDown(&keyboard, &output, 2, 0, 0); // esc
+	KeyboardDown(&keyboard, &output, 3, 95, 120); // z
+	KeyboardDown(&keyboard, &output, 4, 45, 10); // gap
+	TEST_ASSERT_EQUAL_INT(3, keyboard.numContacts);
+	KeyboardUp(&keyboard, &output, 1);
+	KeyboardUp(&keyboard, &output, 4);
+	TEST_ASSERT(IsKeyDown(&output, 'Z'));
+	KeyboardUp(&keyboard, &output, 3);
+	KeyboardUp(&keyboard, &output, 2);
+	TEST_ASSERT_EQUAL_INT(0, keyboard.numContacts);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(4, recorder.numEvents);
+	TEST_ASSERT(!IsKeyDown(&output, 'Z'));
+	TEST_ASSERT(!IsKeyDown(&output, 0x1B));
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TOUCH_JOY_KEYBOARD_H
+#define TOUCH_JOY_KEYBOARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+
+// Keyboards are stored in their button so these bound the size of every
+// button, up to 256 keys such as a full keyboard with a numpad and macros.
+// Key positions must fit a byte.
+#define MAX_KEYBOARD_ROWS 8
+#define MAX_ROW_KEYS 32
+// Keys are positioned in quarters of a key width
+#define KEYBOARD_SUBDIVISIONS 4
+#define MAX_ROW_LENGTH (MAX_ROW_KEYS * KEYBOARD_SUBDIVISIONS)
+#define MAX_KEYBOARD_CONTACTS 10
+#define NO_KEY 0xFF
+
+typedef struct
+{
+	int numKeys;
+	// Length in quarters of a key
+	int length;
+	uint16_t codes[MAX_ROW_KEYS];
+	uint8_t starts[MAX_ROW_KEYS];
+	uint8_t widths[MAX_ROW_KEYS];
+	// Key under each quarter of the row or NO_KEY for gaps
+	uint8_t lookup[MAX_ROW_LENGTH];
+} KeyboardRow;
+
+typedef struct
+{
+	uint32_t id;
+	uint16_t code;
+} KeyboardContact;
+
+// A grid of keys on a single surface.
+// Keys are found by arithmetic on the grid so the cost of a touch does not
+// depend on the number of keys.
+typedef struct
+{
+	// Size of a one unit key in pixels
+	int keyWidth;
+	int keyHeight;
+	int numRows;
+	KeyboardRow rows[MAX_KEYBOARD_ROWS];
+
+	// Keys held by each finger
+	int numContacts;
+	KeyboardContact contacts[MAX_KEYBOARD_CONTACTS];
+} Keyboard;
+
+void InitKeyboard(Keyboard* keyboard);
+// Add a row such as "tab:1.5 q w e _:0.5 ..." where each key is a key name
+// with an optional width in keys and "_" is an empty space
+bool AddKeyboardRow(Keyboard* keyboard, const char* source, const char** error);
+// Size of the whole grid in pixels
+int GetKeyboardWidth(const Keyboard* keyboard);
+int GetKeyboardHeight(const Keyboard* keyboard);
+// Code of the key at a position in pixels relative to the grid or 0
+uint16_t HitTestKeyboard(const Keyboard* keyboard, int x, int y);
+// Press the key under a new contact
+void KeyboardDown(Keyboard* keyboard, Output* output, uint32_t id, int x, int y);
+// Release the key held by a contact
+void KeyboardUp(Keyboard* keyboard, Output* output, uint32_t id);
+
+#endif
@@ -0,0 +1,127 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include "keys.h"
+
+typedef struct
+{
+	const char* name;
+	uint16_t code;
+} KeyName;
+
+// Virtual key codes are spelled out so this file does not need Windows.h
+static const KeyName KEY_NAMES[] = {
+	{ "backspace", 0x08 },
+	{ "tab", 0x09 },
+	{ "enter", 0x0D },
+	{ "shift", 0x10 },
+	{ "ctrl", 0x11 },
+	{ "alt", 0x12 },
+	{ "pause", 0x13 },
+	{ "capslock", 0x14 },
+	{ "esc", 0x1B },
+	{ "space", 0x20 },
+	{ "pageup", 0x21 },
+	{ "pagedown", 0x22 },
+	{ "end", 0x23 },
+	{ "home", 0x24 },
+	{ "left", 0x25 },
+	{ "up", 0x26 },
+	{ "right", 0x27 },
+	{ "down", 0x28 },
+	{ "printscreen", 0x2C },
+	{ "insert", 0x2D },
+	{ "delete", 0x2E },
+	{ "win", 0x5B },
+	{ "menu", 0x5D },
+	{ "num0", 0x60 },
+	{ "num1", 0x61 },
+	{ "num2", 0x62 },
+	{ "num3", 0x63 },
+	{ "num4", 0x64 },
+	{ "num5", 0x65 },
+	{ "num6", 0x66 },
+	{ "num7", 0x67 },
+	{ "num8", 0x68 },
+	{ "num9", 0x69 },
+	{ "multiply", 0x6A },
+	{ "add", 0x6B },
+	{ "subtract", 0x6D },
+	{ "decimal", 0x6E },
+	{ "divide", 0x6F },
+	{ "numlock", 0x90 },
+	{ "scrolllock", 0x91 },
+	{ ";", 0xBA },
+	// ";" starts a comment in an ini file
+	{ "semicolon", 0xBA },
+	{ "=", 0xBB },
+	{ ",", 0xBC },
+	{ "-", 0xBD },
+	{ ".", 0xBE },
+	{ "/", 0xBF },
+	{ "`", 0xC0 },
+	{ "[", 0xDB },
+	{ "\\", 0xDC },
+	{ "]", 0xDD },
+	{ "'", 0xDE }
+};
+
+bool ParseKeyCode(const char* name, size_t length, uint16_t* code)
+{
+	if (length == 0) { return false; }
+
+	// Numeric code
+	if (length > 2 && name[0] == '0' && (name[1] == 'x' || name[1] == 'X'))
+	{
+		char* end;
+		long value = strtol(name, &end, 16);
+		if ((size_t)(end - name) != length || value <= 0 || value > 0xFF)
+		{
+			return false;
+		}
+
+		*code = (uint16_t)value;
+		return true;
+	}
+
+	// Letters and digits map to their uppercase ASCII value
+	if (length == 1 && isalnum((unsigned char)name[0]))
+	{
+		*code = (uint16_t)toupper((unsigned char)name[0]);
+		return true;
+	}
+
+	// Function keys
+	if ((name[0] == 'f' || name[0] == 'F') && length >= 2 && length <= 3)
+	{
+		int number = 0;
+		for (size_t i = 1; i < length; ++i)
+		{
+			if (!isdigit((unsigned char)name[i])) { number = 0; break; }
+			number = number * 10 + (name[i] - '0');
+		}
+
+		if (number >= 1 && number <= 24)
+		{
+			*code = (uint16_t)(0x70 + number - 1);
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]); ++i)
+	{
+		const char* keyName = KEY_NAMES[i].name;
+		size_t j = 0;
+		while (j < length && keyName[j] && tolower((unsigned char)name[j]) == keyName[j])
+		{
+			++j;
+		}
+
+		if (j == length && keyName[j] == 0)
+		{
+			*code = KEY_NAMES[i].code;
+			return true;
+		}
+	}
+
+	return false;
+}
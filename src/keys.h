@@ -0,0 +1,12 @@
+#ifndef TOUCH_JOY_KEYS_H
+#define TOUCH_JOY_KEYS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Resolve a key name ("ctrl", "x", "f5", ...) or a numeric virtual key code
+// ("0x41") to a virtual key code
+bool ParseKeyCode(const char* name, size_t length, uint16_t* code);
+
+#endif
@@ -0,0 +1,429 @@
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include "macro.h"
+#include "keys.h"
+#include "utils.h"
+
+#define MAX_MACRO_WAIT 65535
+
+typedef struct
+{
+	const char* start;
+	const char* end;
+} Token;
+
+typedef struct
+{
+	MacroProgram* program;
+	const char* error;
+	int numHeld;
+	uint16_t held[MAX_MACRO_HELD];
+} MacroCompiler;
+
+static Token Trim(const char* start, const char* end)
+{
+	while (start < end && isspace((unsigned char)*start)) { ++start; }
+	while (end > start && isspace((unsigned char)end[-1])) { --end; }
+
+	Token token = { start, end };
+	return token;
+}
+
+// Split off the first word of a token
+static bool TakeWord(Token* token, const char* word)
+{
+	size_t length = strlen(word);
+	if ((size_t)(token->end - token->start) < length) { return false; }
+	if (memcmp(token->start, word, length) != 0) { return false; }
+
+	const char* next = token->start + length;
+	if (next < token->end && !isspace((unsigned char)*next)) { return false; }
+
+	*token = Trim(next, token->end);
+	return true;
+}
+
+static int FindHeld(const uint16_t* held, int numHeld, uint16_t code)
+{
+	for (int i = 0; i < numHeld; ++i)
+	{
+		if (held[i] == code) { return i; }
+	}
+
+	return -1;
+}
+
+static bool EmitOp(MacroCompiler* compiler, MacroOpType type, uint16_t arg)
+{
+	MacroProgram* program = compiler->program;
+	if (program->numOps == MAX_MACRO_OPS)
+	{
+		compiler->error = "Macro is too long";
+		return false;
+	}
+
+	// Track held keys so playback can never leave a key stuck
+	int heldIndex = FindHeld(compiler->held, compiler->numHeld, arg);
+	if (type == MACRO_KEY_DOWN)
+	{
+		if (heldIndex >= 0)
+		{
+			compiler->error = "Key is already pressed";
+			return false;
+		}
+
+		if (compiler->numHeld == MAX_MACRO_HELD)
+		{
+			compiler->error = "Too many keys held";
+			return false;
+		}
+
+		compiler->held[compiler->numHeld++] = arg;
+	}
+	else if (type == MACRO_KEY_UP)
+	{
+		if (heldIndex < 0)
+		{
+			compiler->error = "Key is not pressed";
+			return false;
+		}
+
+		compiler->held[heldIndex] = compiler->held[--compiler->numHeld];
+	}
+
+	MacroOp* op = &program->ops[program->numOps++];
+	op->type = (uint8_t)type;
+	op->arg = arg;
+	return true;
+}
+
+static bool CompileWait(MacroCompiler* compiler, Token token)
+{
+	char* end;
+	long wait = strtol(token.start, &end, 10);
+
+	if (end == token.start || wait <= 0 || wait > MAX_MACRO_WAIT)
+	{
+		compiler->error = "Invalid macro wait";
+		return false;
+	}
+
+	Token unit = Trim(end, token.end);
+	if (unit.start != unit.end
+		&& !(unit.end - unit.start == 2 && memcmp(unit.start, "ms", 2) == 0))
+	{
+		compiler->error = "Invalid macro wait";
+		return false;
+	}
+
+	return EmitOp(compiler, MACRO_WAIT, (uint16_t)wait);
+}
+
+static bool CompileCombo(MacroCompiler* compiler, Token token, bool press, bool release)
+{
+	uint16_t codes[MAX_MACRO_HELD];
+	int numCodes = 0;
+
+	const char* cursor = token.start;
+	while (cursor <= token.end)
+	{
+		const char* keyEnd = memchr(cursor, '+', token.end - cursor);
+		if (keyEnd == NULL) { keyEnd = token.end; }
+
+		Token key = Trim(cursor, keyEnd);
+		if (numCodes == MAX_MACRO_HELD)
+		{
+			compiler->error = "Too many keys held";
+			return false;
+		}
+
+		if (!ParseKeyCode(key.start, key.end - key.start, &codes[numCodes++]))
+		{
+			compiler->error = "Invalid macro key";
+			return false;
+		}
+
+		cursor = keyEnd + 1;
+	}
+
+	if (press)
+	{
+		for (int i = 0; i < numCodes; ++i)
+		{
+			if (!EmitOp(compiler, MACRO_KEY_DOWN, codes[i])) { return false; }
+		}
+	}
+
+	if (release)
+	{
+		for (int i = numCodes - 1; i >= 0; --i)
+		{
+			if (!EmitOp(compiler, MACRO_KEY_UP, codes[i])) { return false; }
+		}
+	}
+
+	return true;
+}
+
+bool CompileMacro(const char* source, MacroProgram* program, const char** error)
+{
+	MacroCompiler compiler;
+	compiler.program = program;
+	compiler.error = NULL;
+	compiler.numHeld = 0;
+	program->numOps = 0;
+
+	const char* cursor = source;
+	for (;;)
+	{
+		const char* stepEnd = strchr(cursor, ',');
+		if (stepEnd == NULL) { stepEnd = cursor + strlen(cursor); }
+
+		Token step = Trim(cursor, stepEnd);
+		bool success;
+		if (step.start == step.end)
+		{
+			compiler.error = "Empty macro step";
+			success = false;
+		}
+		else if (TakeWord(&step, "wait"))
+		{
+			success = CompileWait(&compiler, step);
+		}
+		else if (TakeWord(&step, "press"))
+		{
+			success = CompileCombo(&compiler, step, true, false);
+		}
+		else if (TakeWord(&step, "release"))
+		{
+			success = CompileCombo(&compiler, step, false, true);
+		}
+		else
+		{
+			success = CompileCombo(&compiler, step, true, true);
+		}
+
+		if (!success)
+		{
+			*error = compiler.error;
+			return false;
+		}
+
+		if (*stepEnd == 0) { break; }
+		cursor = stepEnd + 1;
+	}
+
+	return true;
+}
+
+static void ReleaseHeldKeys(MacroPlayer* player)
+{
+	while (player->numHeld > 0)
+	{
+		OutputKey(player->output, player->held[--player->numHeld], false);
+	}
+}
+
+// Execute ops until the next wait. Waits are measured from the time the
+// current step was due rather than from when it actually ran so that late
+// wakeups do not accumulate over a sequence.
+static void RunMacro(MacroPlayer* player, Timestamp due)
+{
+	const MacroProgram* program = player->program;
+
+	while (player->pc < program->numOps)
+	{
+		MacroOp op = program->ops[player->pc++];
+		int heldIndex;
+
+		switch (op.type)
+		{
+		case MACRO_KEY_DOWN:
+			player->held[player->numHeld++] = op.arg;
+			OutputKey(player->output, op.arg, true);
+			break;
+		case MACRO_KEY_UP:
+			heldIndex = FindHeld(player->held, player->numHeld, op.arg);
+			player->held[heldIndex] = player->held[--player->numHeld];
+			OutputKey(player->output, op.arg, false);
+			break;
+		case MACRO_WAIT:
+			if (ScheduleTimer(
+				player->scheduler, &player->timer, due + op.arg * 1000ull
+			))
+			{
+				return;
+			}
+
+			// Out of timers, abort instead of playing the rest unpaced
+			player->pc = program->numOps;
+			break;
+		}
+	}
+
+	ReleaseHeldKeys(player);
+	player->program = NULL;
+}
+
+static void OnMacroTimer(Timer* timer, Timestamp now)
+{
+	UNUSED(now);
+
+	RunMacro((MacroPlayer*)timer->userData, timer->due);
+}
+
+void StartMacro(
+	MacroPlayer* player,
+	const MacroProgram* program,
+	Scheduler* scheduler,
+	Output* output,
+	Timestamp now
+)
+{
+	CancelMacro(player);
+
+	InitTimer(&player->timer, &OnMacroTimer, player);
+	player->scheduler = scheduler;
+	player->output = output;
+	player->program = program;
+	player->pc = 0;
+	player->numHeld = 0;
+
+	RunMacro(player, now);
+}
+
+void CancelMacro(MacroPlayer* player)
+{
+	if (!IsMacroRunning(player)) { return; }
+
+	CancelTimer(player->scheduler, &player->timer);
+	ReleaseHeldKeys(player);
+	player->program = NULL;
+}
+
+bool IsMacroRunning(const MacroPlayer* player)
+{
+	return player->program != NULL;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+static void AssertKey(const RecordedOutput* record, uint16_t code, bool down)
+{
+	TEST_ASSERT_EQUAL_INT(OUTPUT_KEY, record->event.type);
+	TEST_ASSERT_EQUAL_INT(code, record->event.data.key.code);
+	TEST_ASSERT_EQUAL_INT(down, record->event.data.key.down);
+}
+
+TEST(macro_compile)
+{
+	MacroProgram program;
+	const char* error;
+
+	TEST_ASSERT(CompileMacro("ctrl+down, wait 16ms, x", &program, &error));
+	TEST_ASSERT_EQUAL_INT(7, program.numOps);
+	TEST_ASSERT_EQUAL_INT(MACRO_KEY_DOWN, program.ops[0].type);
+	TEST_ASSERT_EQUAL_INT(0x11, program.ops[0].arg);
+	TEST_ASSERT_EQUAL_INT(MACRO_KEY_DOWN, program.ops[1].type);
+	TEST_ASSERT_EQUAL_INT(0x28, program.ops[1].arg);
+	TEST_ASSERT_EQUAL_INT(MACRO_KEY_UP, program.ops[2].type);
+	TEST_ASSERT_EQUAL_INT(0x28, program.ops[2].arg);
+	TEST_ASSERT_EQUAL_INT(MACRO_KEY_UP, program.ops[3].type);
+	TEST_ASSERT_EQUAL_INT(0x11, program.ops[3].arg);
+	TEST_ASSERT_EQUAL_INT(MACRO_WAIT, program.ops[4].type);
+	TEST_ASSERT_EQUAL_INT(16, program.ops[4].arg);
+	TEST_ASSERT_EQUAL_INT(MACRO_KEY_DOWN, program.ops[5].type);
+	TEST_ASSERT_EQUAL_INT('X', program.ops[5].arg);
+
+	TEST_ASSERT(CompileMacro("press 0x41, wait 5, release 0x41", &program, &error));
+	TEST_ASSERT_EQUAL_INT(3, program.numOps);
+
+	TEST_ASSERT(!CompileMacro("x, , y", &program, &error));
+	TEST_ASSERT(!CompileMacro("wait 10s", &program, &error));
+	TEST_ASSERT(!CompileMacro("foo", &program, &error));
+	TEST_ASSERT(!CompileMacro("release x", &program, &error));
+	TEST_ASSERT(!CompileMacro("press x, press x", &program, &error));
+}
+
+TEST(macro_timing)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 1000000;
+	Scheduler scheduler;
+	Output output;
+	MacroProgram program;
+	MacroPlayer player;
+	const char* error;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	memset(&player, 0, sizeof(player));
+
+	TEST_ASSERT(CompileMacro(
+		"a, wait 16ms, b, wait 17ms, press c, wait 100ms, release c",
+		&program, &error
+	));
+
+	Timestamp start = clock;
+	StartMacro(&player, &program, &scheduler, &output, clock);
+	FlushOutput(&output);
+
+	// Simulate a driver which always wakes up late
+	Timestamp due;
+	while (GetNextDeadline(&scheduler, &due))
+	{
+		clock = due + 900;
+		RunScheduler(&scheduler, clock);
+		FlushOutput(&output);
+	}
+
+	TEST_ASSERT(!IsMacroRunning(&player));
+	TEST_ASSERT_EQUAL_INT(6, recorder.numEvents);
+
+	Timestamp expected[] = { 0, 0, 16000, 16000, 33000, 133000 };
+	for (int i = 0; i < recorder.numEvents; ++i)
+	{
+		double offset = (double)(recorder.events[i].time - start);
+		TEST_ASSERT_EQUAL_DOUBLE((double)expected[i], offset, 1000.0);
+	}
+
+	AssertKey(&recorder.events[4], 'C', true);
+	AssertKey(&recorder.events[5], 'C', false);
+}
+
+TEST(macro_cancel)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	MacroProgram program;
+	MacroPlayer player;
+	const char* error;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	memset(&player, 0, sizeof(player));
+
+	TEST_ASSERT(CompileMacro("press shift+a, wait 50ms, release shift+a", &program, &error));
+	StartMacro(&player, &program, &scheduler, &output, clock);
+	TEST_ASSERT(IsMacroRunning(&player));
+
+	clock = 10000;
+	RunScheduler(&scheduler, clock);
+	CancelMacro(&player);
+	FlushOutput(&output);
+
+	TEST_ASSERT(!IsMacroRunning(&player));
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+	TEST_ASSERT_EQUAL_INT(4, recorder.numEvents);
+	AssertKey(&recorder.events[2], 'A', false);
+	AssertKey(&recorder.events[3], 0x10, false);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TOUCH_JOY_MACRO_H
+#define TOUCH_JOY_MACRO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+#define MAX_MACRO_OPS 32
+#define MAX_MACRO_HELD 8
+
+typedef enum
+{
+	MACRO_KEY_DOWN,
+	MACRO_KEY_UP,
+	MACRO_WAIT
+} MacroOpType;
+
+typedef struct
+{
+	uint8_t type;
+	uint16_t arg; // Key code or wait time in milliseconds
+} MacroOp;
+
+typedef struct
+{
+	int numOps;
+	MacroOp ops[MAX_MACRO_OPS];
+} MacroProgram;
+
+// Playback state of one macro run.
+// A zero-initialized player is valid and idle.
+typedef struct
+{
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	const MacroProgram* program;
+	int pc;
+	int numHeld;
+	uint16_t held[MAX_MACRO_HELD];
+} MacroPlayer;
+
+// Compile a sequence such as "ctrl+down, wait 16ms, x".
+//
+// Each comma-separated step is one of:
+// * "a+b": press a then b, release them in reverse order
+// * "press a+b" or "release a+b": only press or release
+// * "wait 16ms": pause playback
+bool CompileMacro(const char* source, MacroProgram* program, const char** error);
+// Start playing a program, cancelling any run in progress.
+// Steps up to the first wait are output immediately.
+void StartMacro(
+	MacroPlayer* player,
+	const MacroProgram* program,
+	Scheduler* scheduler,
+	Output* output,
+	Timestamp now
+);
+// Stop a run, releasing every key it still holds
+void CancelMacro(MacroPlayer* player);
+bool IsMacroRunning(const MacroPlayer* player);
+
+#endif
@@ -5,16 +5,23 @@
 #define WIN32_LEAN_AND_MEAN
 #define VC_EXTRALEAN
 #include <Windows.h>
+#include <mmsystem.h>
 
 #include "gamepad.h"
 #include "gamepad_window.h"
 #include "utils.h"
 
 #define WM_CONFIGCHANGED (WM_USER + 1)
+// Milliseconds before the input thread sends knob positions again when the
+// window thread was too busy to take them
+#define KNOB_RETRY_TIME 10
 
 typedef struct
 {
 	Gamepad gamepad;
+	Scheduler scheduler;
+	Output output;
+	InputChannel channel;
 	char configFile[MAX_PATH];
 	char configDir[MAX_PATH];
 	HANDLE shutdownEvent;
@@ -40,10 +47,19 @@ void ReloadConfig(ProgramState* state)
 	ParseError parseError;
 	if (LoadGamepad(state->configFile, &tempGamepad, &parseError))
 	{
+		// Only the swap itself holds up the input thread, not the loading
+		EnterCriticalSection(&state->channel.lock);
 		DeinitializeGamepad(&state->gamepad);
+		// Send the old layout's key releases while its key mode still applies
+		FlushOutput(&state->output);
 		FreeGamepad(&state->gamepad);
 		state->gamepad = tempGamepad;
-		InitializeGamepad(&state->gamepad);
+		InitializeGamepad(
+			&state->gamepad, &state->scheduler, &state->output, &state->channel
+		);
+		LeaveCriticalSection(&state->channel.lock);
+		// Let the input thread pick up the new layout's timers
+		SetEvent(state->channel.inputReady);
 	}
 	else
 	{
@@ -74,6 +90,18 @@ LRESULT CALLBACK MsgWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	}
 }
 
+DWORD GetSchedulerTimeout(Scheduler* scheduler)
+{
+	Timestamp due;
+	if (!GetNextDeadline(scheduler, &due)) { return INFINITE; }
+
+	Timestamp now = GetTimestamp();
+	if (due <= now) { return 0; }
+
+	// Round up so that we never wake up before the deadline
+	return (DWORD)((due - now + 999) / 1000);
+}
+
 DWORD WINAPI ConfigMonitorProc(LPVOID lpParameter)
 {
 	ProgramState* state = (ProgramState*)lpParameter;
@@ -97,6 +125,40 @@ DWORD WINAPI ConfigMonitorProc(LPVOID lpParameter)
 	return 0;
 }
 
+// Touches are handled and output is injected here so that painting and
+// reloading on the window thread never delay them. The scheduler and output
+// belong to this thread.
+DWORD WINAPI InputThreadProc(LPVOID lpParameter)
+{
+	ProgramState* state = (ProgramState*)lpParameter;
+	InputChannel* channel = &state->channel;
+
+	DWORD timeout = 0;
+	while (state->running)
+	{
+		// Woken up by queued input or the next scheduled timer
+		WaitForSingleObject(channel->inputReady, timeout);
+
+		EnterCriticalSection(&channel->lock);
+		Timestamp now = GetTimestamp();
+		HandleQueuedInputs(&state->gamepad, now);
+		RunScheduler(&state->scheduler, now);
+		// Inject everything produced in this iteration at once
+		FlushOutput(&state->output);
+		RecordInjection(channel, GetTimestamp());
+		SendKnobs(&state->gamepad);
+
+		timeout = GetSchedulerTimeout(&state->scheduler);
+		if (state->gamepad.movedKnobs && timeout > KNOB_RETRY_TIME)
+		{
+			timeout = KNOB_RETRY_TIME;
+		}
+		LeaveCriticalSection(&channel->lock);
+	}
+
+	return 0;
+}
+
 int CALLBACK WinMain(
 	HINSTANCE hInstance,
 	HINSTANCE hPrevInstance,
@@ -127,9 +189,18 @@ int CALLBACK WinMain(
 		return -1;
 	}
 
+	// Timed outputs such as macros need better than the default 15.6ms
+	// timer resolution
+	timeBeginPeriod(1);
+	InitScheduler(&state.scheduler);
+	InitOutput(&state.output, &SendInputSink, &state.gamepad);
+	InitInputChannel(&state.channel);
+
 	// Display gamepad
 	RegisterGamepadWindowClass();
-	InitializeGamepad(&state.gamepad);
+	InitializeGamepad(
+		&state.gamepad, &state.scheduler, &state.output, &state.channel
+	);
 
 	// Create a window to receive change notifications
 	WNDCLASS wc;
@@ -152,26 +223,67 @@ int CALLBACK WinMain(
 	);
 
 	// Create a thread to monitor changes to config file
+	state.running = true;
 	state.shutdownEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 	HANDLE threadHandle = CreateThread(
 		NULL, 0, &ConfigMonitorProc, &state, 0, NULL
 	);
 
+	// Hand input over to its own thread, ahead of everything else running
+	HANDLE inputThread = CreateThread(
+		NULL, 0, &InputThreadProc, &state, 0, NULL
+	);
+	SetThreadPriority(inputThread, THREAD_PRIORITY_HIGHEST);
+
 	// Message loop
-	state.running = true;
+	// Instead of blocking in GetMessage, wait for either a message or knob
+	// positions sent by the input thread.
 	MSG msg;
-	while (GetMessage(&msg, NULL, 0, 0) > 0)
+	msg.wParam = 0;
+	bool quit = false;
+	while (!quit)
 	{
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
+		MsgWaitForMultipleObjects(
+			1, &state.channel.knobsReady, FALSE, INFINITE, QS_ALLINPUT
+		);
+
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		{
+			if (msg.message == WM_QUIT)
+			{
+				quit = true;
+				break;
+			}
+
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+
+		DrawKnobs(&state.gamepad);
 	}
 	state.running = false;
 
 	SetEvent(state.shutdownEvent);
+	SetEvent(state.channel.inputReady);
+	WaitForSingleObject(inputThread, INFINITE);
 	WaitForSingleObject(threadHandle, INFINITE);
 	DeinitializeGamepad(&state.gamepad);
+	FlushOutput(&state.output);
 	FreeGamepad(&state.gamepad);
 
+	LatencyStats* latency = &state.channel.latency;
+	if (latency->count)
+	{
+		DebugPrint(
+			"Touch to injection latency: %u us mean, %u us max over %u inputs",
+			(unsigned)GetMeanLatency(latency),
+			(unsigned)latency->max,
+			latency->count
+		);
+	}
+	FreeInputChannel(&state.channel);
+	timeEndPeriod(1);
+
 	return (int)msg.wParam;
 }
 
@@ -179,6 +291,43 @@ int CALLBACK WinMain(
 
 #include "utest.h"
 
+DECLARE_TEST(macro_compile)
+DECLARE_TEST(macro_timing)
+DECLARE_TEST(macro_cancel)
+DECLARE_TEST(trackpad_subpixel)
+DECLARE_TEST(output_key_refcount)
+DECLARE_TEST(wheel_continuous)
+DECLARE_TEST(pwm_duty_cycle)
+DECLARE_TEST(typematic_repeat)
+DECLARE_TEST(motion_recognizer)
+DECLARE_TEST(chord_resolve)
+DECLARE_TEST(chord_passthrough)
+DECLARE_TEST(slider_detents)
+DECLARE_TEST(dial_rotation)
+DECLARE_TEST(keyboard_grid)
+DECLARE_TEST(trackball_inertia)
+DECLARE_TEST(curve_lookup)
+DECLARE_TEST(touch_contacts)
+DECLARE_TEST(tracker_slide)
+DECLARE_TEST(tracker_coalesce)
+DECLARE_TEST(grid_query)
+DECLARE_TEST(grid_density)
+DECLARE_TEST(filter_chatter)
+DECLARE_TEST(gesture_timing)
+DECLARE_TEST(floating_origin)
+DECLARE_TEST(ring_order)
+DECLARE_TEST(knob_stall)
+DECLARE_TEST(knob_stall_latency)
+DECLARE_TEST(evdev_parse)
+DECLARE_TEST(evdev_replay)
+DECLARE_TEST(predict_replay)
+#ifdef _BENCHMARK
+DECLARE_TEST(chord_benchmark)
+DECLARE_TEST(grid_benchmark)
+DECLARE_TEST(evdev_benchmark)
+DECLARE_TEST(predict_benchmark)
+#endif
+
 TEST(parse_ini)
 {
 	Gamepad gamepad;
@@ -219,16 +368,148 @@ TEST(parse_ini_fail)
 
 	TEST_ASSERT(!LoadGamepad("fail.ini", &gamepad, &err));
 	TEST_ASSERT_EQUAL_INT(2, err.line);
+
+	// 0x10041 would wrap to 'A' if it were narrowed before the range check
+	TEST_ASSERT(!LoadGamepad("badcode.ini", &gamepad, &err));
+	TEST_ASSERT_EQUAL_INT(3, err.line);
+}
+
+TEST(parse_ini_scancode)
+{
+	Gamepad gamepad;
+	ParseError err;
+
+	TEST_ASSERT(LoadGamepad("scancode.ini", &gamepad, &err));
+	TEST_ASSERT_EQUAL_INT(KEY_MODE_SCANCODE, gamepad.keyMode);
+	TEST_ASSERT_EQUAL_INT(1, gamepad.numButtons);
+	// Arrow keys are extended keys
+	TEST_ASSERT_EQUAL_INT(0xE04B, gamepad.scanCodes[VK_LEFT]);
+	TEST_ASSERT_EQUAL_INT(0x01, gamepad.scanCodes[VK_ESCAPE]);
+}
+
+TEST(parse_ini_layers)
+{
+	Gamepad gamepad;
+	ParseError err;
+
+	TEST_ASSERT(LoadGamepad("layers.ini", &gamepad, &err));
+	TEST_ASSERT_EQUAL_INT(4, gamepad.numButtons);
+	TEST_ASSERT_EQUAL_INT(BTN_LAYER, gamepad.buttons[1].type);
+	TEST_ASSERT_EQUAL_INT(2, gamepad.buttons[1].extras.layer.layer);
+	TEST_ASSERT(gamepad.buttons[1].extras.layer.toggle);
+
+	TEST_ASSERT_EQUAL_INT(0x41, gamepad.keymap[0][2][0]);
+	TEST_ASSERT_EQUAL_INT(0x42, gamepad.keymap[1][2][0]);
+	TEST_ASSERT_EQUAL_INT(0x43, gamepad.keymap[2][2][0]);
+	// Codes which are not overridden are inherited from the base layer
+	TEST_ASSERT_EQUAL_INT(0x41, gamepad.keymap[3][2][0]);
+	TEST_ASSERT_EQUAL_INT(0x26, gamepad.keymap[1][3][STICK_UP]);
+	TEST_ASSERT_EQUAL_INT(0x53, gamepad.keymap[1][3][STICK_DOWN]);
+	TEST_ASSERT_EQUAL_INT(0x57, gamepad.keymap[2][3][STICK_UP]);
+}
+
+TEST(parse_ini_chords)
+{
+	Gamepad gamepad;
+	ParseError err;
+
+	TEST_ASSERT(LoadGamepad("chords.ini", &gamepad, &err));
+	TEST_ASSERT_EQUAL_INT(3, gamepad.numButtons);
+	TEST_ASSERT_EQUAL_INT(BTN_CHORD, gamepad.buttons[2].type);
+	TEST_ASSERT_EQUAL_INT(1, gamepad.chords.numChords);
+	TEST_ASSERT_EQUAL_INT(0x3, gamepad.chords.chords[0].buttons);
+	TEST_ASSERT_EQUAL_INT(0x43, gamepad.chords.chords[0].code);
+	TEST_ASSERT_EQUAL_INT(30000, (int)gamepad.chords.chords[0].window);
+	TEST_ASSERT_EQUAL_INT(0x3, gamepad.chords.chordButtons);
+}
+
+TEST(parse_ini_keyboard)
+{
+	Gamepad gamepad;
+	ParseError err;
+
+	TEST_ASSERT(LoadGamepad("keyboard.ini", &gamepad, &err));
+	TEST_ASSERT_EQUAL_INT(1, gamepad.numButtons);
+
+	Button* button = &gamepad.buttons[0];
+	TEST_ASSERT_EQUAL_INT(BTN_KEYBOARD, button->type);
+	TEST_ASSERT_EQUAL_INT(6, button->extras.keyboard.numRows);
+
+	int numKeys = 0;
+	for (int i = 0; i < button->extras.keyboard.numRows; ++i)
+	{
+		numKeys += button->extras.keyboard.rows[i].numKeys;
+	}
+	TEST_ASSERT_EQUAL_INT(103, numKeys);
+	// A ";" in a row would start a comment and cut the rest of it off
+	TEST_ASSERT_EQUAL_INT(16, button->extras.keyboard.rows[3].numKeys);
+
+	// The window covers the whole grid
+	TEST_ASSERT_EQUAL_INT(6 * 48, button->height);
+	TEST_ASSERT_EQUAL_INT(VK_F1, HitTestKeyboard(&button->extras.keyboard, 2 * 48, 0));
+	TEST_ASSERT_EQUAL_INT(
+		VK_RETURN, HitTestKeyboard(&button->extras.keyboard, 13 * 48, 3 * 48)
+	);
 }
 
 TEST_FIXTURE_BEGIN(all)
 	TEST_FIXTURE_TEST(parse_ini)
 	TEST_FIXTURE_TEST(parse_ini_fail)
+	TEST_FIXTURE_TEST(parse_ini_scancode)
+	TEST_FIXTURE_TEST(parse_ini_layers)
+	TEST_FIXTURE_TEST(parse_ini_chords)
+	TEST_FIXTURE_TEST(parse_ini_keyboard)
+	TEST_FIXTURE_TEST(macro_compile)
+	TEST_FIXTURE_TEST(macro_timing)
+	TEST_FIXTURE_TEST(macro_cancel)
+	TEST_FIXTURE_TEST(trackpad_subpixel)
+	TEST_FIXTURE_TEST(output_key_refcount)
+	TEST_FIXTURE_TEST(wheel_continuous)
+	TEST_FIXTURE_TEST(pwm_duty_cycle)
+	TEST_FIXTURE_TEST(typematic_repeat)
+	TEST_FIXTURE_TEST(motion_recognizer)
+	TEST_FIXTURE_TEST(chord_resolve)
+	TEST_FIXTURE_TEST(chord_passthrough)
+	TEST_FIXTURE_TEST(slider_detents)
+	TEST_FIXTURE_TEST(dial_rotation)
+	TEST_FIXTURE_TEST(keyboard_grid)
+	TEST_FIXTURE_TEST(trackball_inertia)
+	TEST_FIXTURE_TEST(curve_lookup)
+	TEST_FIXTURE_TEST(touch_contacts)
+	TEST_FIXTURE_TEST(tracker_slide)
+	TEST_FIXTURE_TEST(tracker_coalesce)
+	TEST_FIXTURE_TEST(grid_query)
+	TEST_FIXTURE_TEST(grid_density)
+	TEST_FIXTURE_TEST(filter_chatter)
+	TEST_FIXTURE_TEST(gesture_timing)
+	TEST_FIXTURE_TEST(floating_origin)
+	TEST_FIXTURE_TEST(ring_order)
+	TEST_FIXTURE_TEST(knob_stall)
+	TEST_FIXTURE_TEST(knob_stall_latency)
+	TEST_FIXTURE_TEST(evdev_parse)
+	TEST_FIXTURE_TEST(evdev_replay)
+	TEST_FIXTURE_TEST(predict_replay)
+TEST_FIXTURE_END()
+
+#ifdef _BENCHMARK
+// Timed separately so that the tests stay quick and independent of the
+// machine's load
+TEST_FIXTURE_BEGIN(benchmarks)
+	TEST_FIXTURE_TEST(chord_benchmark)
+	TEST_FIXTURE_TEST(grid_benchmark)
+	TEST_FIXTURE_TEST(evdev_benchmark)
+	TEST_FIXTURE_TEST(predict_benchmark)
 TEST_FIXTURE_END()
+#endif
 
 int main()
 {
+#ifdef _BENCHMARK
+	if (utest_run_fixture(all) != TEST_RESULT_SUCCESS) { return TEST_RESULT_FAILED; }
+	return utest_run_fixture(benchmarks);
+#else
 	return utest_run_fixture(all);
+#endif
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motion.h"
+
+#define HISTORY_AT(INDEX) ((INDEX) & (MOTION_HISTORY_SIZE - 1))
+
+// Build the KMP automaton: on a mismatch, fall back to the longest proper
+// suffix of what was matched which is also a prefix of the pattern.
+static void BuildAutomaton(MotionPattern* pattern)
+{
+	int fallback = 0;
+
+	for (int symbol = 0; symbol < MOTION_SYMBOLS; ++symbol)
+	{
+		pattern->next[0][symbol] = 0;
+	}
+	pattern->next[0][pattern->directions[0]] = 1;
+
+	for (int state = 1; state <= pattern->length; ++state)
+	{
+		for (int symbol = 0; symbol < MOTION_SYMBOLS; ++symbol)
+		{
+			pattern->next[state][symbol] = pattern->next[fallback][symbol];
+		}
+
+		if (state < pattern->length)
+		{
+			// A stick passes through neutral when released from a charge,
+			// so stay put instead of losing the charge
+			if (pattern->charges[state - 1] != 0
+				&& pattern->directions[state] != MOTION_NEUTRAL)
+			{
+				pattern->next[state][MOTION_NEUTRAL] = (uint8_t)state;
+			}
+
+			pattern->next[state][pattern->directions[state]] = (uint8_t)(state + 1);
+			fallback = pattern->next[fallback][pattern->directions[state]];
+		}
+	}
+
+	pattern->state = 0;
+}
+
+bool CompileMotion(const char* source, MotionPattern* pattern, const char** error)
+{
+	pattern->length = 0;
+
+	for (const char* cursor = source; *cursor;)
+	{
+		if (isspace((unsigned char)*cursor))
+		{
+			++cursor;
+		}
+		else if (*cursor >= '1' && *cursor <= '9')
+		{
+			if (pattern->length == MAX_MOTION_LENGTH)
+			{
+				*error = "Motion is too long";
+				return false;
+			}
+
+			pattern->directions[pattern->length] = (uint8_t)(*cursor - '0');
+			pattern->charges[pattern->length] = 0;
+			++pattern->length;
+			++cursor;
+		}
+		else if (*cursor == ':' && pattern->length > 0)
+		{
+			char* end;
+			long charge = strtol(cursor + 1, &end, 10);
+			if (end == cursor + 1 || charge <= 0 || charge > 65535)
+			{
+				*error = "Invalid charge time";
+				return false;
+			}
+
+			pattern->charges[pattern->length - 1] = (uint16_t)charge;
+			cursor = end;
+		}
+		else
+		{
+			*error = "Invalid motion";
+			return false;
+		}
+	}
+
+	if (pattern->length == 0)
+	{
+		*error = "Invalid motion";
+		return false;
+	}
+
+	// Consecutive identical directions can never be seen since the history
+	// only records changes
+	for (int i = 1; i < pattern->length; ++i)
+	{
+		if (pattern->directions[i] == pattern->directions[i - 1])
+		{
+			*error = "Repeated direction in motion";
+			return false;
+		}
+	}
+
+	// A charge is only complete once the next direction is entered
+	if (pattern->charges[pattern->length - 1] != 0)
+	{
+		*error = "Charge on last direction of motion";
+		return false;
+	}
+
+	BuildAutomaton(pattern);
+	return true;
+}
+
+int GetStickDirection(bool up, bool down, bool left, bool right)
+{
+	int column = left ? 0 : (right ? 2 : 1);
+	int row = down ? 0 : (up ? 2 : 1);
+
+	return row * 3 + column + 1;
+}
+
+bool PushMotion(MotionHistory* history, int direction, Timestamp now)
+{
+	if (history->count > 0)
+	{
+		int last = HISTORY_AT(history->count - 1);
+		if (history->directions[last] == direction) { return false; }
+	}
+
+	int index = HISTORY_AT(history->count);
+	history->directions[index] = (uint8_t)direction;
+	history->times[index] = now;
+	++history->count;
+
+	// Keep the counter bounded without losing its position in the ring
+	if (history->count >= MOTION_HISTORY_SIZE * 2)
+	{
+		history->count -= MOTION_HISTORY_SIZE;
+	}
+
+	return true;
+}
+
+static bool CheckTiming(const MotionPattern* pattern, const MotionHistory* history)
+{
+	Timestamp charging = 0;
+	int entry = history->count - 1;
+	Timestamp end = history->times[HISTORY_AT(entry)];
+
+	// Walk the match backwards since a charge may have skipped a neutral
+	for (int i = pattern->length - 2; i >= 0; --i)
+	{
+		Timestamp released = history->times[HISTORY_AT(entry)];
+		--entry;
+		if (history->directions[HISTORY_AT(entry)] != pattern->directions[i])
+		{
+			released = history->times[HISTORY_AT(entry)];
+			--entry;
+		}
+
+		if (pattern->charges[i] == 0) { continue; }
+
+		Timestamp start = history->times[HISTORY_AT(entry)];
+		if (released - start < pattern->charges[i] * 1000ull) { return false; }
+
+		charging += released - start;
+	}
+
+	Timestamp start = history->times[HISTORY_AT(entry)];
+	return end - start - charging <= pattern->window * 1000ull;
+}
+
+bool MatchMotion(MotionPattern* pattern, const MotionHistory* history)
+{
+	if (history->count == 0) { return false; }
+
+	int direction = history->directions[HISTORY_AT(history->count - 1)];
+	pattern->state = pattern->next[pattern->state][direction];
+
+	return pattern->state == pattern->length && CheckTiming(pattern, history);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+typedef struct
+{
+	int direction;
+	int time;
+} MotionStep;
+
+// Feed a scripted stick motion and count how many times the pattern fires
+static int ReplayMotion(MotionPattern* pattern, const MotionStep* steps, int numSteps)
+{
+	MotionHistory history;
+	memset(&history, 0, sizeof(history));
+	pattern->state = 0;
+
+	int matches = 0;
+	for (int i = 0; i < numSteps; ++i)
+	{
+		if (PushMotion(&history, steps[i].direction, steps[i].time * 1000ull)
+			&& MatchMotion(pattern, &history))
+		{
+			++matches;
+		}
+	}
+
+	return matches;
+}
+
+TEST(motion_recognizer)
+{
+	MotionPattern pattern;
+	const char* error;
+
+	TEST_ASSERT_EQUAL_INT(2, GetStickDirection(false, true, false, false));
+	TEST_ASSERT_EQUAL_INT(3, GetStickDirection(false, true, false, true));
+	TEST_ASSERT_EQUAL_INT(5, GetStickDirection(false, false, false, false));
+	TEST_ASSERT_EQUAL_INT(7, GetStickDirection(true, false, true, false));
+
+	// Quarter circle forward
+	TEST_ASSERT(CompileMotion("236", &pattern, &error));
+	pattern.window = 200;
+	MotionStep quarterCircle[] = {
+		{ 5, 0 }, { 2, 10 }, { 3, 40 }, { 6, 80 }
+	};
+	TEST_ASSERT_EQUAL_INT(1, ReplayMotion(&pattern, quarterCircle, 4));
+
+	MotionStep slowQuarterCircle[] = {
+		{ 2, 0 }, { 3, 150 }, { 6, 300 }
+	};
+	TEST_ASSERT_EQUAL_INT(0, ReplayMotion(&pattern, slowQuarterCircle, 3));
+
+	// A false start is recovered from by the automaton
+	MotionStep falseStart[] = {
+		{ 2, 0 }, { 1, 10 }, { 2, 20 }, { 3, 30 }, { 6, 40 }, { 5, 50 }
+	};
+	TEST_ASSERT_EQUAL_INT(1, ReplayMotion(&pattern, falseStart, 6));
+
+	// Charge back then forward
+	TEST_ASSERT(CompileMotion("4:500 6", &pattern, &error));
+	pattern.window = 100;
+	MotionStep charge[] = {
+		{ 4, 0 }, { 6, 600 }
+	};
+	TEST_ASSERT_EQUAL_INT(1, ReplayMotion(&pattern, charge, 2));
+	MotionStep shortCharge[] = {
+		{ 4, 0 }, { 6, 300 }
+	};
+	TEST_ASSERT_EQUAL_INT(0, ReplayMotion(&pattern, shortCharge, 2));
+
+	// Released through neutral, as a touch stick always is
+	MotionStep chargeThroughNeutral[] = {
+		{ 4, 0 }, { 5, 600 }, { 6, 620 }
+	};
+	TEST_ASSERT_EQUAL_INT(1, ReplayMotion(&pattern, chargeThroughNeutral, 3));
+	MotionStep shortChargeThroughNeutral[] = {
+		{ 4, 0 }, { 5, 300 }, { 6, 320 }
+	};
+	TEST_ASSERT_EQUAL_INT(0, ReplayMotion(&pattern, shortChargeThroughNeutral, 3));
+	MotionStep slowRelease[] = {
+		{ 4, 0 }, { 5, 600 }, { 6, 800 }
+	};
+	TEST_ASSERT_EQUAL_INT(0, ReplayMotion(&pattern, slowRelease, 3));
+	// Charging again after a release only counts the last hold
+	MotionStep recharge[] = {
+		{ 4, 0 }, { 5, 600 }, { 4, 620 }, { 5, 700 }, { 6, 720 }
+	};
+	TEST_ASSERT_EQUAL_INT(0, ReplayMotion(&pattern, recharge, 5));
+
+	// Double tap, overlapping taps fire again
+	TEST_ASSERT(CompileMotion("656", &pattern, &error));
+	pattern.window = 250;
+	MotionStep doubleTap[] = {
+		{ 6, 0 }, { 5, 50 }, { 6, 100 }, { 5, 150 }, { 6, 200 }
+	};
+	TEST_ASSERT_EQUAL_INT(2, ReplayMotion(&pattern, doubleTap, 5));
+
+	TEST_ASSERT(!CompileMotion("2x6", &pattern, &error));
+	TEST_ASSERT(!CompileMotion("266", &pattern, &error));
+	TEST_ASSERT(!CompileMotion("4 6:500", &pattern, &error));
+	TEST_ASSERT(!CompileMotion(":10", &pattern, &error));
+	TEST_ASSERT(!CompileMotion("", &pattern, &error));
+}
+
+#endif
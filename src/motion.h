@@ -0,0 +1,50 @@
+#ifndef TOUCH_JOY_MOTION_H
+#define TOUCH_JOY_MOTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+#define MAX_MOTION_LENGTH 8
+// Must be a power of two no smaller than MAX_MOTION_LENGTH
+#define MOTION_HISTORY_SIZE 16
+// Directions use numpad notation: 1 to 9 with 5 as neutral
+#define MOTION_SYMBOLS 10
+#define MOTION_NEUTRAL 5
+
+// Recent stick directions, one entry per direction change
+typedef struct
+{
+	int count;
+	uint8_t directions[MOTION_HISTORY_SIZE];
+	Timestamp times[MOTION_HISTORY_SIZE];
+} MotionHistory;
+
+// A motion input such as a quarter circle ("236"), a charge ("4:500 6")
+// or a double tap ("656").
+//
+// Patterns are compiled into a deterministic automaton over directions so
+// matching costs one table lookup per direction change. Timing is only
+// checked once the whole pattern has been seen. A single neutral after a
+// charged direction is skipped, so "4:500 6" also matches 4 5 6.
+typedef struct
+{
+	int length;
+	uint8_t directions[MAX_MOTION_LENGTH];
+	// Minimum milliseconds each direction has to be held
+	uint16_t charges[MAX_MOTION_LENGTH];
+	// Maximum milliseconds for the whole motion, not counting charging
+	int window;
+	uint8_t next[MAX_MOTION_LENGTH + 1][MOTION_SYMBOLS];
+	uint8_t state;
+} MotionPattern;
+
+bool CompileMotion(const char* source, MotionPattern* pattern, const char** error);
+int GetStickDirection(bool up, bool down, bool left, bool right);
+// Return false if the direction did not change
+bool PushMotion(MotionHistory* history, int direction, Timestamp now);
+// Feed the latest direction in the history to the pattern.
+// Return true when it completes the motion.
+bool MatchMotion(MotionPattern* pattern, const MotionHistory* history);
+
+#endif
@@ -0,0 +1,193 @@
+#include <string.h>
+#include "output.h"
+
+static OutputEvent* AllocEvent(Output* output, OutputType type)
+{
+	// Flush early rather than dropping events
+	if (output->numEvents == MAX_OUTPUT_EVENTS) { FlushOutput(output); }
+
+	OutputEvent* event = &output->events[output->numEvents++];
+	event->type = type;
+	return event;
+}
+
+void InitOutput(Output* output, OutputSink sink, void* sinkData)
+{
+	output->sink = sink;
+	output->sinkData = sinkData;
+	output->numEvents = 0;
+	memset(output->keyRefs, 0, sizeof(output->keyRefs));
+	memset(output->keyBits, 0, sizeof(output->keyBits));
+}
+
+static void EmitKey(Output* output, uint16_t code, bool down)
+{
+	OutputEvent* event = AllocEvent(output, OUTPUT_KEY);
+	event->data.key.code = code;
+	event->data.key.down = down;
+}
+
+void OutputKey(Output* output, uint16_t code, bool down)
+{
+	if (code == 0 || code >= MAX_KEY_CODES) { return; }
+
+	uint32_t bit = 1u << (code % 32);
+	uint32_t* word = &output->keyBits[code / 32];
+
+	if (down)
+	{
+		if (output->keyRefs[code]++ > 0) { return; }
+
+		*word |= bit;
+	}
+	else
+	{
+		// Ignore unbalanced releases
+		if (output->keyRefs[code] == 0) { return; }
+		if (--output->keyRefs[code] > 0) { return; }
+
+		*word &= ~bit;
+	}
+
+	EmitKey(output, code, down);
+}
+
+void OutputKeyRepeat(Output* output, uint16_t code)
+{
+	if (IsKeyDown(output, code)) { EmitKey(output, code, true); }
+}
+
+bool IsKeyDown(const Output* output, uint16_t code)
+{
+	if (code >= MAX_KEY_CODES) { return false; }
+
+	return (output->keyBits[code / 32] & (1u << (code % 32))) != 0;
+}
+
+void ReleaseAllKeys(Output* output)
+{
+	for (int i = 0; i < MAX_KEY_CODES / 32; ++i)
+	{
+		uint32_t bits = output->keyBits[i];
+		for (int bit = 0; bits != 0; ++bit, bits >>= 1)
+		{
+			if (bits & 1) { EmitKey(output, (uint16_t)(i * 32 + bit), false); }
+		}
+
+		output->keyBits[i] = 0;
+	}
+
+	memset(output->keyRefs, 0, sizeof(output->keyRefs));
+}
+
+void OutputMouseMove(Output* output, int dx, int dy)
+{
+	if (output->numEvents > 0)
+	{
+		OutputEvent* last = &output->events[output->numEvents - 1];
+		if (last->type == OUTPUT_MOUSE_MOVE)
+		{
+			last->data.move.dx += dx;
+			last->data.move.dy += dy;
+			return;
+		}
+	}
+
+	OutputEvent* event = AllocEvent(output, OUTPUT_MOUSE_MOVE);
+	event->data.move.dx = dx;
+	event->data.move.dy = dy;
+}
+
+void OutputMouseAbsolute(Output* output, int x, int y)
+{
+	OutputEvent* event = AllocEvent(output, OUTPUT_MOUSE_ABSOLUTE);
+	event->data.position.x = x;
+	event->data.position.y = y;
+}
+
+void OutputWheel(Output* output, int delta)
+{
+	OutputEvent* event = AllocEvent(output, OUTPUT_WHEEL);
+	event->data.wheel.delta = delta;
+}
+
+void FlushOutput(Output* output)
+{
+	if (output->numEvents == 0) { return; }
+
+	output->sink(output->sinkData, output->events, output->numEvents);
+	output->numEvents = 0;
+}
+
+void InitOutputRecorder(OutputRecorder* recorder, const Timestamp* clock)
+{
+	recorder->clock = clock;
+	recorder->numEvents = 0;
+}
+
+void RecordOutput(void* userData, const OutputEvent* events, int numEvents)
+{
+	OutputRecorder* recorder = (OutputRecorder*)userData;
+
+	for (int i = 0; i < numEvents; ++i)
+	{
+		if (recorder->numEvents == MAX_RECORDED_OUTPUTS) { return; }
+
+		RecordedOutput* record = &recorder->events[recorder->numEvents++];
+		record->time = *recorder->clock;
+		record->event = events[i];
+	}
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(output_key_refcount)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Output output;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+
+	// A stick and a button both holding VK_UP
+	OutputKey(&output, 0x26, true);
+	OutputKey(&output, 0x26, true);
+	TEST_ASSERT(IsKeyDown(&output, 0x26));
+
+	// Releasing one of them must not release the key
+	OutputKey(&output, 0x26, false);
+	TEST_ASSERT(IsKeyDown(&output, 0x26));
+
+	OutputKey(&output, 0x26, false);
+	TEST_ASSERT(!IsKeyDown(&output, 0x26));
+
+	// Unbalanced release is dropped
+	OutputKey(&output, 0x26, false);
+
+	OutputKey(&output, 0x41, true);
+	OutputKey(&output, 0x41, true);
+	OutputKey(&output, 0xA0, true);
+	ReleaseAllKeys(&output);
+	TEST_ASSERT(!IsKeyDown(&output, 0x41));
+	TEST_ASSERT(!IsKeyDown(&output, 0xA0));
+
+	FlushOutput(&output);
+
+	TEST_ASSERT_EQUAL_INT(6, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(0x26, recorder.events[0].event.data.key.code);
+	TEST_ASSERT(recorder.events[0].event.data.key.down);
+	TEST_ASSERT_EQUAL_INT(0x26, recorder.events[1].event.data.key.code);
+	TEST_ASSERT(!recorder.events[1].event.data.key.down);
+	TEST_ASSERT(!recorder.events[4].event.data.key.down);
+	TEST_ASSERT(!recorder.events[5].event.data.key.down);
+
+	// Counts start from scratch after a release all
+	OutputKey(&output, 0x41, true);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(7, recorder.numEvents);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef TOUCH_JOY_OUTPUT_H
+#define TOUCH_JOY_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+#define MAX_OUTPUT_EVENTS 64
+#define MAX_RECORDED_OUTPUTS 1024
+#define MAX_KEY_CODES 256
+// Microseconds a key pressed for a single event such as a tap or a step is
+// held, so that games polling once a frame see it
+#define KEY_PULSE_LENGTH 30000
+
+typedef enum
+{
+	OUTPUT_KEY,
+	OUTPUT_MOUSE_MOVE,
+	OUTPUT_MOUSE_ABSOLUTE,
+	OUTPUT_WHEEL
+} OutputType;
+
+typedef struct
+{
+	OutputType type;
+	union
+	{
+		struct
+		{
+			uint16_t code;
+			bool down;
+		} key;
+
+		struct
+		{
+			int dx;
+			int dy;
+		} move;
+
+		// Absolute coordinates in [0, 65535]
+		struct
+		{
+			int x;
+			int y;
+		} position;
+
+		// WHEEL_DELTA units
+		struct
+		{
+			int delta;
+		} wheel;
+	} data;
+} OutputEvent;
+
+// Receives a batch of events to inject
+typedef void(*OutputSink)(void* userData, const OutputEvent* events, int numEvents);
+
+// Output events are batched and handed to the sink together on flush.
+//
+// Several controls can hold the same key at once so key state is reference
+// counted: only the first press and the last release of a key are output.
+typedef struct
+{
+	OutputSink sink;
+	void* sinkData;
+	int numEvents;
+	OutputEvent events[MAX_OUTPUT_EVENTS];
+	uint8_t keyRefs[MAX_KEY_CODES];
+	uint32_t keyBits[MAX_KEY_CODES / 32];
+} Output;
+
+typedef struct
+{
+	Timestamp time;
+	OutputEvent event;
+} RecordedOutput;
+
+// A sink which stores events instead of injecting them.
+// Events are stamped with the current value of clock.
+typedef struct
+{
+	const Timestamp* clock;
+	int numEvents;
+	RecordedOutput events[MAX_RECORDED_OUTPUTS];
+} OutputRecorder;
+
+void InitOutput(Output* output, OutputSink sink, void* sinkData);
+void OutputKey(Output* output, uint16_t code, bool down);
+// Output another press of a held key, as keyboard auto repeat does
+void OutputKeyRepeat(Output* output, uint16_t code);
+bool IsKeyDown(const Output* output, uint16_t code);
+// Release every key regardless of how many controls are holding it
+void ReleaseAllKeys(Output* output);
+// Relative mouse motion. Consecutive moves are merged into one event.
+void OutputMouseMove(Output* output, int dx, int dy);
+void OutputMouseAbsolute(Output* output, int x, int y);
+void OutputWheel(Output* output, int delta);
+void FlushOutput(Output* output);
+
+void InitOutputRecorder(OutputRecorder* recorder, const Timestamp* clock);
+// OutputSink for an OutputRecorder
+void RecordOutput(void* userData, const OutputEvent* events, int numEvents);
+
+#endif
@@ -0,0 +1,335 @@
+#include <math.h>
+#include "predict.h"
+
+// Correct the axis with a sample and return the error of its prediction
+static float TrackAxis(PredictedAxis* axis, float value, float period)
+{
+	float predicted = axis->position + axis->velocity * period;
+	float residual = value - predicted;
+	axis->position = predicted + PREDICT_ALPHA * residual;
+	axis->velocity += PREDICT_BETA * residual / period;
+
+	return residual;
+}
+
+void InitMotionPredictor(MotionPredictor* predictor)
+{
+	predictor->horizon = 0;
+	predictor->gate = DEFAULT_PREDICT_GATE;
+	ResetMotionPredictor(predictor);
+}
+
+void SetPredictionHorizon(MotionPredictor* predictor, Timestamp horizon)
+{
+	predictor->horizon = horizon;
+}
+
+bool IsPredictionEnabled(const MotionPredictor* predictor)
+{
+	return predictor->horizon > 0;
+}
+
+void ResetMotionPredictor(MotionPredictor* predictor)
+{
+	predictor->primed = false;
+}
+
+void PredictTouch(MotionPredictor* predictor, float* x, float* y, Timestamp time)
+{
+	if (!IsPredictionEnabled(predictor)) { return; }
+
+	if (!predictor->primed)
+	{
+		predictor->primed = true;
+		predictor->lastTime = time;
+		predictor->x.position = *x;
+		predictor->x.velocity = 0.f;
+		predictor->y.position = *y;
+		predictor->y.velocity = 0.f;
+		predictor->error = 0.f;
+		predictor->step = 0.f;
+		predictor->confidence = 0.f;
+		return;
+	}
+
+	Timestamp elapsed = time > predictor->lastTime ? time - predictor->lastTime : 0;
+	if (elapsed < MIN_PREDICT_PERIOD) { elapsed = MIN_PREDICT_PERIOD; }
+	predictor->lastTime = time;
+	float period = (float)elapsed / 1000000.f;
+
+	float errorX = TrackAxis(&predictor->x, *x, period);
+	float errorY = TrackAxis(&predictor->y, *y, period);
+	float velocityX = predictor->x.velocity;
+	float velocityY = predictor->y.velocity;
+
+	float error = sqrtf(errorX * errorX + errorY * errorY);
+	float step = sqrtf(velocityX * velocityX + velocityY * velocityY) * period;
+	predictor->error += PREDICT_ERROR_SMOOTHING * (error - predictor->error);
+	predictor->step += PREDICT_STEP_SMOOTHING * (step - predictor->step);
+
+	// Steady motion moves much further per sample than the tracker is off
+	// by. Jitter at rest and erratic strokes do not.
+	float stepSquared = predictor->step * predictor->step;
+	float gatedError = predictor->gate * predictor->error;
+	float weight = stepSquared + gatedError * gatedError;
+	predictor->confidence = weight > 0.f ? stepSquared / weight : 0.f;
+
+	// Extrapolate from the sample itself so that no confidence leaves it as is
+	float ahead = (float)predictor->horizon / 1000000.f * predictor->confidence;
+	*x += velocityX * ahead;
+	*y += velocityY * ahead;
+}
+
+#ifdef _TEST
+
+#include <stddef.h>
+#include "utest.h"
+#include "utils.h"
+
+#define PI 3.14159265f
+// A 120 Hz digitizer reporting where the finger was 12 ms earlier
+#define EVAL_PERIOD 8333
+#define EVAL_DELAY 12000
+#define EVAL_LENGTH 1200
+#define EVAL_HORIZON 12000
+// Knots of the erratic trace
+#define ERRATIC_PERIOD 25000
+#define ERRATIC_KNOTS ((EVAL_LENGTH * EVAL_PERIOD + EVAL_DELAY) / ERRATIC_PERIOD + 2)
+// Horizontal key boundaries of a 100 pixel stick with a threshold of 50%
+#define LEFT_BOUNDARY 25.f
+#define RIGHT_BOUNDARY 75.f
+#define MAX_TRANSITIONS 256
+
+typedef enum
+{
+	TRACE_FLICKS,
+	TRACE_ERRATIC
+} TraceKind;
+
+typedef struct
+{
+	TraceKind kind;
+	float knots[ERRATIC_KNOTS];
+} Trace;
+
+static unsigned int NextRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245u + 12345u;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+static float Ease(float from, float to, float progress)
+{
+	return from + (to - from) * (1.f - cosf(PI * progress)) / 2.f;
+}
+
+// A thumb flicking a stick from one side to the other: held for 150 ms,
+// then swept across in 80 ms
+static float FlickAt(Timestamp time)
+{
+	Timestamp cycle = time % 460000;
+	if (cycle < 150000) { return 85.f; }
+	if (cycle < 230000) { return Ease(85.f, 15.f, (float)(cycle - 150000) / 80000.f); }
+	if (cycle < 380000) { return 15.f; }
+	return Ease(15.f, 85.f, (float)(cycle - 380000) / 80000.f);
+}
+
+static float TruthAt(const Trace* trace, Timestamp time)
+{
+	if (trace->kind == TRACE_FLICKS) { return FlickAt(time); }
+
+	int knot = (int)(time / ERRATIC_PERIOD);
+	float progress = (float)(time % ERRATIC_PERIOD) / (float)ERRATIC_PERIOD;
+	return trace->knots[knot] + (trace->knots[knot + 1] - trace->knots[knot]) * progress;
+}
+
+static void MakeTrace(Trace* trace, TraceKind kind)
+{
+	unsigned int seed = 11;
+	trace->kind = kind;
+	for (int i = 0; i < ERRATIC_KNOTS; ++i)
+	{
+		trace->knots[i] = 50.f + (float)(NextRandom(&seed) % 61) - 30.f;
+	}
+}
+
+// Key of the horizontal axis held at a position: -1, 0 or 1
+static int GetKey(float x)
+{
+	return x < LEFT_BOUNDARY ? -1 : (x > RIGHT_BOUNDARY ? 1 : 0);
+}
+
+typedef struct
+{
+	float meanError;
+	int numTransitions;
+	Timestamp transitions[MAX_TRANSITIONS];
+} Replay;
+
+static void RecordTransition(Replay* replay, Timestamp time)
+{
+	if (replay->numTransitions < MAX_TRANSITIONS)
+	{
+		replay->transitions[replay->numTransitions] = time;
+	}
+	++replay->numTransitions;
+}
+
+// Feed the samples of a trace, which lag behind the finger, to a predictor
+// or none and measure how far the result is from where the finger is
+static void ReplayTrace(const Trace* trace, MotionPredictor* predictor, Replay* replay)
+{
+	unsigned int seed = 5;
+	float totalError = 0.f;
+	int key = 0;
+	replay->numTransitions = 0;
+	if (predictor) { ResetMotionPredictor(predictor); }
+
+	for (int i = 0; i < EVAL_LENGTH; ++i)
+	{
+		Timestamp time = (Timestamp)i * EVAL_PERIOD + EVAL_DELAY;
+		// Half a pixel of digitizer jitter
+		float noise = (float)(NextRandom(&seed) % 101) / 100.f - 0.5f;
+		float x = TruthAt(trace, time - EVAL_DELAY) + noise;
+		float y = 50.f;
+		if (predictor) { PredictTouch(predictor, &x, &y, time); }
+
+		totalError += fabsf(x - TruthAt(trace, time));
+		int newKey = GetKey(x);
+		if (newKey != key) { RecordTransition(replay, time); }
+		key = newKey;
+	}
+
+	replay->meanError = totalError / (float)EVAL_LENGTH;
+}
+
+// Mean time by which the keys of a replay change after those of the finger
+static float GetMeanLag(const Replay* replay, const Replay* truth)
+{
+	float total = 0.f;
+	for (int i = 0; i < truth->numTransitions; ++i)
+	{
+		total += (float)replay->transitions[i] - (float)truth->transitions[i];
+	}
+
+	return total / (float)truth->numTransitions / 1000.f;
+}
+
+// Where the finger really is, sampled at the same times as a replay
+static void ReplayTruth(const Trace* trace, Replay* truth)
+{
+	int key = 0;
+	truth->numTransitions = 0;
+	for (int i = 0; i < EVAL_LENGTH; ++i)
+	{
+		Timestamp time = (Timestamp)i * EVAL_PERIOD + EVAL_DELAY;
+		int newKey = GetKey(TruthAt(trace, time));
+		if (newKey != key) { RecordTransition(truth, time); }
+		key = newKey;
+	}
+}
+
+// Replay flicks without and with prediction
+static void ReplayFlicks(
+	Trace* trace, MotionPredictor* predictor, Replay* truth, Replay* raw, Replay* predicted
+)
+{
+	MakeTrace(trace, TRACE_FLICKS);
+	ReplayTruth(trace, truth);
+	ReplayTrace(trace, NULL, raw);
+	ReplayTrace(trace, predictor, predicted);
+}
+
+// Erratic strokes turn every 25 ms, faster than the delay. Replay them
+// without prediction, with it and with it never backing off.
+static void ReplayErratic(
+	Trace* trace, MotionPredictor* predictor, Replay* raw, Replay* predicted, Replay* ungated
+)
+{
+	MakeTrace(trace, TRACE_ERRATIC);
+	ReplayTrace(trace, NULL, raw);
+	ReplayTrace(trace, predictor, predicted);
+	float gate = predictor->gate;
+	predictor->gate = 0.f;
+	ReplayTrace(trace, predictor, ungated);
+	predictor->gate = gate;
+}
+
+TEST(predict_replay)
+{
+	static Trace trace;
+	MotionPredictor predictor;
+	InitMotionPredictor(&predictor);
+	SetPredictionHorizon(&predictor, EVAL_HORIZON);
+
+	Replay truth;
+	Replay raw;
+	Replay predicted;
+	ReplayFlicks(&trace, &predictor, &truth, &raw, &predicted);
+	TEST_ASSERT(truth.numTransitions > 10 && truth.numTransitions <= MAX_TRANSITIONS);
+
+	// Every key change happens once, sooner than without prediction
+	TEST_ASSERT(raw.numTransitions == truth.numTransitions);
+	TEST_ASSERT(predicted.numTransitions == truth.numTransitions);
+	float rawLag = GetMeanLag(&raw, &truth);
+	float predictedLag = GetMeanLag(&predicted, &truth);
+	TEST_ASSERT(predicted.meanError < raw.meanError * 0.75f);
+	TEST_ASSERT(rawLag - predictedLag >= 4.f);
+
+	// Prediction backs off instead of overshooting each turn
+	Replay ungated;
+	ReplayErratic(&trace, &predictor, &raw, &predicted, &ungated);
+	TEST_ASSERT(predicted.meanError <= raw.meanError * 1.1f);
+	TEST_ASSERT(predicted.meanError < ungated.meanError);
+
+	// The first sample of a contact is left as is
+	InitMotionPredictor(&predictor);
+	SetPredictionHorizon(&predictor, EVAL_HORIZON);
+	float x = 10.f;
+	float y = 20.f;
+	PredictTouch(&predictor, &x, &y, 0);
+	TEST_ASSERT(x == 10.f && y == 20.f);
+	// Nor is anything without a horizon
+	SetPredictionHorizon(&predictor, 0);
+	x = 30.f;
+	PredictTouch(&predictor, &x, &y, EVAL_PERIOD);
+	TEST_ASSERT(x == 30.f);
+}
+
+#ifdef _BENCHMARK
+
+TEST(predict_benchmark)
+{
+	static Trace trace;
+	MotionPredictor predictor;
+	InitMotionPredictor(&predictor);
+	SetPredictionHorizon(&predictor, EVAL_HORIZON);
+
+	Replay truth;
+	Replay raw;
+	Replay predicted;
+	ReplayFlicks(&trace, &predictor, &truth, &raw, &predicted);
+	TEST_ASSERT(truth.numTransitions > 0 && truth.numTransitions <= MAX_TRANSITIONS);
+	ReportBenchmark(
+		"predict_benchmark",
+		"flicks, error %.2f px -> %.2f px, key lag %.1f ms -> %.1f ms",
+		raw.meanError,
+		predicted.meanError,
+		GetMeanLag(&raw, &truth),
+		GetMeanLag(&predicted, &truth)
+	);
+
+	Replay ungated;
+	ReplayErratic(&trace, &predictor, &raw, &predicted, &ungated);
+	ReportBenchmark(
+		"predict_benchmark",
+		"erratic, error %.2f px -> %.2f px, %.2f px ungated",
+		raw.meanError,
+		predicted.meanError,
+		ungated.meanError
+	);
+}
+
+#endif
+
+#endif
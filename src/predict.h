@@ -0,0 +1,62 @@
+#ifndef TOUCH_JOY_PREDICT_H
+#define TOUCH_JOY_PREDICT_H
+
+#include <stdbool.h>
+#include "scheduler.h"
+
+// Share of the error between a sample and its prediction which corrects the
+// position and, per sample period, the velocity
+#define PREDICT_ALPHA 0.5f
+#define PREDICT_BETA 0.5f
+// Samples closer than this many microseconds are treated as this far apart
+#define MIN_PREDICT_PERIOD 1000
+// Weight of the latest sample in the running averages of motion and error.
+// Errors are averaged longer so that a finger starting to move is trusted
+// before its acceleration settles.
+#define PREDICT_STEP_SMOOTHING 0.6f
+#define PREDICT_ERROR_SMOOTHING 0.1f
+// How much larger than the tracker's error the motion per sample must be for
+// the prediction to be trusted
+#define DEFAULT_PREDICT_GATE 2.f
+
+typedef struct
+{
+	float position;
+	// Per second
+	float velocity;
+} PredictedAxis;
+
+// Extrapolates a touch position a short time ahead to make up for the delay
+// of the digitizer. An alpha-beta tracker estimates the velocity, and the
+// extrapolation is scaled down when motion is erratic: when the tracker's
+// recent errors are large compared to how far the finger moves per sample.
+// It is disabled until given a horizon.
+typedef struct
+{
+	// Microseconds ahead
+	Timestamp horizon;
+	// 0 trusts every extrapolation
+	float gate;
+
+	bool primed;
+	Timestamp lastTime;
+	PredictedAxis x;
+	PredictedAxis y;
+	// Running averages of the tracker's error and of the distance between
+	// samples, in pixels
+	float error;
+	float step;
+	// In [0, 1], the share of the extrapolation applied
+	float confidence;
+} MotionPredictor;
+
+void InitMotionPredictor(MotionPredictor* predictor);
+void SetPredictionHorizon(MotionPredictor* predictor, Timestamp horizon);
+bool IsPredictionEnabled(const MotionPredictor* predictor);
+// Forget the previous contact, its first position is not extrapolated
+void ResetMotionPredictor(MotionPredictor* predictor);
+// Replace a position in pixels, sampled at the given time, with where the
+// finger is expected to be a horizon later
+void PredictTouch(MotionPredictor* predictor, float* x, float* y, Timestamp time);
+
+#endif
@@ -0,0 +1,192 @@
+#include <string.h>
+#include "pwm.h"
+
+static void SetPressed(Pwm* pwm, int channel, uint16_t code)
+{
+	if (pwm->pressed[channel] == code) { return; }
+
+	if (pwm->pressed[channel]) { OutputKey(pwm->output, pwm->pressed[channel], false); }
+	if (code) { OutputKey(pwm->output, code, true); }
+
+	pwm->pressed[channel] = code;
+}
+
+// Key state is a pure function of time within the period so late wakeups
+// only delay an edge, they never shift the carrier.
+static void RunPwm(Pwm* pwm, Timestamp now)
+{
+	bool active = false;
+	for (int i = 0; i < PWM_CHANNELS; ++i)
+	{
+		if (pwm->duty[i] > 0.f) { active = true; }
+	}
+
+	if (!active)
+	{
+		for (int i = 0; i < PWM_CHANNELS; ++i) { SetPressed(pwm, i, 0); }
+
+		CancelTimer(pwm->scheduler, &pwm->timer);
+		pwm->running = false;
+		return;
+	}
+
+	if (!pwm->running)
+	{
+		pwm->running = true;
+		pwm->periodStart = now;
+	}
+
+	Timestamp periodEnd = pwm->periodStart + pwm->period;
+	if (now >= periodEnd)
+	{
+		pwm->periodStart = periodEnd;
+		// Skip whole periods missed during a stall
+		if (now - pwm->periodStart >= pwm->period) { pwm->periodStart = now; }
+
+		periodEnd = pwm->periodStart + pwm->period;
+	}
+
+	Timestamp next = periodEnd;
+	for (int i = 0; i < PWM_CHANNELS; ++i)
+	{
+		float duty = pwm->duty[i];
+		Timestamp releaseTime =
+			pwm->periodStart + (Timestamp)(duty * (float)pwm->period);
+		bool down = duty >= 1.f || (duty > 0.f && now < releaseTime);
+
+		SetPressed(pwm, i, down ? pwm->codes[i] : 0);
+
+		if (down && duty < 1.f && releaseTime < next) { next = releaseTime; }
+	}
+
+	ScheduleTimer(pwm->scheduler, &pwm->timer, next);
+}
+
+static void OnPwmTimer(Timer* timer, Timestamp now)
+{
+	RunPwm((Pwm*)timer->userData, now);
+}
+
+void InitPwm(Pwm* pwm, Timestamp period)
+{
+	memset(pwm, 0, sizeof(Pwm));
+	pwm->period = period;
+}
+
+void SetPwmDuty(Pwm* pwm, int channel, uint16_t code, float duty)
+{
+	if (duty < 0.f) { duty = 0.f; }
+	if (duty > 1.f) { duty = 1.f; }
+
+	pwm->codes[channel] = code;
+	pwm->duty[channel] = duty;
+}
+
+void UpdatePwm(Pwm* pwm, Scheduler* scheduler, Output* output, Timestamp now)
+{
+	if (!pwm->running) { InitTimer(&pwm->timer, &OnPwmTimer, pwm); }
+	pwm->scheduler = scheduler;
+	pwm->output = output;
+
+	RunPwm(pwm, now);
+}
+
+void StopPwm(Pwm* pwm)
+{
+	if (!pwm->scheduler) { return; }
+
+	for (int i = 0; i < PWM_CHANNELS; ++i) { pwm->duty[i] = 0.f; }
+
+	RunPwm(pwm, 0);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+// Fraction of [start, end) during which code was held according to the
+// recorded output
+static double MeasureDuty(
+	const OutputRecorder* recorder, uint16_t code, Timestamp start, Timestamp end
+)
+{
+	Timestamp held = 0;
+	Timestamp pressTime = 0;
+	bool down = false;
+
+	for (int i = 0; i < recorder->numEvents; ++i)
+	{
+		const RecordedOutput* record = &recorder->events[i];
+		if (record->event.type != OUTPUT_KEY) { continue; }
+		if (record->event.data.key.code != code) { continue; }
+
+		Timestamp time = record->time;
+		if (time < start) { time = start; }
+		if (time > end) { time = end; }
+
+		if (record->event.data.key.down)
+		{
+			pressTime = time;
+			down = true;
+		}
+		else if (down)
+		{
+			held += time - pressTime;
+			down = false;
+		}
+	}
+
+	if (down) { held += end - pressTime; }
+
+	return (double)held / (double)(end - start);
+}
+
+TEST(pwm_duty_cycle)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Pwm sticks[2];
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+
+	// Two sticks with different carriers sharing one scheduler
+	InitPwm(&sticks[0], 50000);
+	InitPwm(&sticks[1], 33000);
+	SetPwmDuty(&sticks[0], 0, 'A', 0.3f);
+	SetPwmDuty(&sticks[0], 1, 'W', 0.75f);
+	SetPwmDuty(&sticks[1], 0, 'J', 0.5f);
+	UpdatePwm(&sticks[0], &scheduler, &output, clock);
+	UpdatePwm(&sticks[1], &scheduler, &output, clock);
+	FlushOutput(&output);
+
+	// Wake up late by a pseudo random amount of up to 1ms
+	uint32_t seed = 1;
+	Timestamp end = 2000000;
+	Timestamp due;
+	while (GetNextDeadline(&scheduler, &due) && due < end)
+	{
+		seed = seed * 1103515245 + 12345;
+		clock = due + (seed >> 16) % 1000;
+		RunScheduler(&scheduler, clock);
+		FlushOutput(&output);
+	}
+
+	clock = end;
+	StopPwm(&sticks[0]);
+	StopPwm(&sticks[1]);
+	FlushOutput(&output);
+
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+	TEST_ASSERT_EQUAL_DOUBLE(0.3, MeasureDuty(&recorder, 'A', 0, end), 0.02);
+	TEST_ASSERT_EQUAL_DOUBLE(0.75, MeasureDuty(&recorder, 'W', 0, end), 0.02);
+	TEST_ASSERT_EQUAL_DOUBLE(0.5, MeasureDuty(&recorder, 'J', 0, end), 0.02);
+	TEST_ASSERT(!IsKeyDown(&output, 'A'));
+	TEST_ASSERT(!IsKeyDown(&output, 'W'));
+	TEST_ASSERT(!IsKeyDown(&output, 'J'));
+}
+
+#endif
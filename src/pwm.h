@@ -0,0 +1,34 @@
+#ifndef TOUCH_JOY_PWM_H
+#define TOUCH_JOY_PWM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+#define PWM_CHANNELS 2
+
+// Pulse-width modulated key output.
+// Each channel holds its key for duty * period at the start of every period.
+typedef struct
+{
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	Timestamp period;
+	Timestamp periodStart;
+	bool running;
+	float duty[PWM_CHANNELS];
+	uint16_t codes[PWM_CHANNELS];
+	// Key currently held by each channel, 0 when released
+	uint16_t pressed[PWM_CHANNELS];
+} Pwm;
+
+void InitPwm(Pwm* pwm, Timestamp period);
+// Takes effect on the next UpdatePwm
+void SetPwmDuty(Pwm* pwm, int channel, uint16_t code, float duty);
+void UpdatePwm(Pwm* pwm, Scheduler* scheduler, Output* output, Timestamp now);
+// Release all keys and stop the carrier
+void StopPwm(Pwm* pwm);
+
+#endif
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "ring.h"
+
+// Each side publishes its index with release semantics and reads the other
+// side's with acquire semantics, so an item is fully written before it can
+// be popped and fully read before its slot can be reused
+#ifdef _MSC_VER
+#include <intrin.h>
+// Interlocked operations are full barriers
+#define LOAD_INDEX(index) ((uint32_t)_InterlockedOr((volatile long*)&(index), 0))
+#define STORE_INDEX(index, value) \
+	_InterlockedExchange((volatile long*)&(index), (long)(value))
+#else
+#define LOAD_INDEX(index) __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define STORE_INDEX(index, value) \
+	__atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+#endif
+
+void InitRing(RingBuffer* ring, void* items, uint32_t itemSize, uint32_t capacity)
+{
+	ring->items = (uint8_t*)items;
+	ring->itemSize = itemSize;
+	ring->mask = capacity - 1;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+// Indices grow freely and wrap around, only their difference matters
+bool PushRing(RingBuffer* ring, const void* item)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = LOAD_INDEX(ring->head);
+	if (tail - head > ring->mask) { return false; }
+
+	memcpy(ring->items + (tail & ring->mask) * ring->itemSize, item, ring->itemSize);
+	STORE_INDEX(ring->tail, tail + 1);
+
+	return true;
+}
+
+bool PopRing(RingBuffer* ring, void* item)
+{
+	uint32_t head = ring->head;
+	uint32_t tail = LOAD_INDEX(ring->tail);
+	if (head == tail) { return false; }
+
+	memcpy(item, ring->items + (head & ring->mask) * ring->itemSize, ring->itemSize);
+	STORE_INDEX(ring->head, head + 1);
+
+	return true;
+}
+
+void ResetLatency(LatencyStats* stats)
+{
+	stats->count = 0;
+	stats->total = 0;
+	stats->max = 0;
+}
+
+void RecordLatency(LatencyStats* stats, Timestamp start, Timestamp end)
+{
+	Timestamp latency = end > start ? end - start : 0;
+
+	++stats->count;
+	stats->total += latency;
+	if (latency > stats->max) { stats->max = latency; }
+}
+
+Timestamp GetMeanLatency(const LatencyStats* stats)
+{
+	return stats->count ? stats->total / stats->count : 0;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(ring_order)
+{
+	RingBuffer ring;
+	int items[4];
+	InitRing(&ring, items, sizeof(int), 4);
+
+	int value;
+	TEST_ASSERT(!PopRing(&ring, &value));
+
+	// Go around several times, filling the ring each time
+	int pushed = 0;
+	int popped = 0;
+	for (int round = 0; round < 5; ++round)
+	{
+		while (PushRing(&ring, &pushed)) { ++pushed; }
+		TEST_ASSERT(pushed - popped == 4);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			TEST_ASSERT(PopRing(&ring, &value));
+			TEST_ASSERT(value == popped);
+			++popped;
+		}
+	}
+
+	while (PopRing(&ring, &value))
+	{
+		TEST_ASSERT(value == popped);
+		++popped;
+	}
+	TEST_ASSERT(popped == pushed);
+
+	// Indices wrapping past 2^32 make no difference
+	InitRing(&ring, items, sizeof(int), 4);
+	ring.head = ring.tail = 0xFFFFFFFE;
+	for (int i = 0; i < 4; ++i) { TEST_ASSERT(PushRing(&ring, &i)); }
+	TEST_ASSERT(!PushRing(&ring, &value));
+	for (int i = 0; i < 4; ++i)
+	{
+		TEST_ASSERT(PopRing(&ring, &value));
+		TEST_ASSERT(value == i);
+	}
+	TEST_ASSERT(!PopRing(&ring, &value));
+
+	LatencyStats stats;
+	ResetLatency(&stats);
+	TEST_ASSERT(GetMeanLatency(&stats) == 0);
+	RecordLatency(&stats, 100, 300);
+	RecordLatency(&stats, 100, 200);
+	// A clock read out of order counts as no latency
+	RecordLatency(&stats, 100, 50);
+	TEST_ASSERT(stats.count == 3 && stats.max == 200 && GetMeanLatency(&stats) == 100);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TOUCH_JOY_RING_H
+#define TOUCH_JOY_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+// Keeps the indices written by each side on separate cache lines
+#define RING_PADDING 60
+
+// Fixed size queue between exactly one producer thread and one consumer
+// thread. Neither side ever waits for the other: pushing to a full ring and
+// popping from an empty one fail immediately.
+// Storage is provided by the owner and holds capacity items of itemSize
+// bytes, capacity being a power of two.
+typedef struct
+{
+	uint8_t* items;
+	uint32_t itemSize;
+	uint32_t mask;
+	// Only written by the consumer
+	volatile uint32_t head;
+	uint8_t headPadding[RING_PADDING];
+	// Only written by the producer
+	volatile uint32_t tail;
+	uint8_t tailPadding[RING_PADDING];
+} RingBuffer;
+
+// Running figures of how long items take from being produced to their
+// effect, such as a touch to the input it injects
+typedef struct
+{
+	uint32_t count;
+	Timestamp total;
+	Timestamp max;
+} LatencyStats;
+
+void InitRing(RingBuffer* ring, void* items, uint32_t itemSize, uint32_t capacity);
+// Producer side, return false when the ring is full
+bool PushRing(RingBuffer* ring, const void* item);
+// Consumer side, return false when the ring is empty
+bool PopRing(RingBuffer* ring, void* item);
+
+void ResetLatency(LatencyStats* stats);
+void RecordLatency(LatencyStats* stats, Timestamp start, Timestamp end);
+Timestamp GetMeanLatency(const LatencyStats* stats);
+
+#endif
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "scheduler.h"
+
+static void PlaceTimer(Scheduler* scheduler, Timer* timer, int index)
+{
+	scheduler->heap[index] = timer;
+	timer->slot = index + 1;
+}
+
+static void SiftUp(Scheduler* scheduler, int index)
+{
+	Timer* timer = scheduler->heap[index];
+
+	while (index > 0)
+	{
+		int parent = (index - 1) / 2;
+		if (scheduler->heap[parent]->due <= timer->due) { break; }
+
+		PlaceTimer(scheduler, scheduler->heap[parent], index);
+		index = parent;
+	}
+
+	PlaceTimer(scheduler, timer, index);
+}
+
+static void SiftDown(Scheduler* scheduler, int index)
+{
+	Timer* timer = scheduler->heap[index];
+
+	for (;;)
+	{
+		int child = index * 2 + 1;
+		if (child >= scheduler->numTimers) { break; }
+
+		if (child + 1 < scheduler->numTimers
+			&& scheduler->heap[child + 1]->due < scheduler->heap[child]->due)
+		{
+			++child;
+		}
+
+		if (timer->due <= scheduler->heap[child]->due) { break; }
+
+		PlaceTimer(scheduler, scheduler->heap[child], index);
+		index = child;
+	}
+
+	PlaceTimer(scheduler, timer, index);
+}
+
+void InitScheduler(Scheduler* scheduler)
+{
+	scheduler->numTimers = 0;
+}
+
+void InitTimer(Timer* timer, TimerProc proc, void* userData)
+{
+	memset(timer, 0, sizeof(Timer));
+	timer->proc = proc;
+	timer->userData = userData;
+}
+
+bool ScheduleTimer(Scheduler* scheduler, Timer* timer, Timestamp due)
+{
+	if (timer->slot)
+	{
+		// Already pending, just move it to its new position
+		Timestamp oldDue = timer->due;
+		timer->due = due;
+
+		if (due < oldDue)
+		{
+			SiftUp(scheduler, timer->slot - 1);
+		}
+		else
+		{
+			SiftDown(scheduler, timer->slot - 1);
+		}
+
+		return true;
+	}
+
+	if (scheduler->numTimers == MAX_TIMERS) { return false; }
+
+	timer->due = due;
+	int index = scheduler->numTimers++;
+	PlaceTimer(scheduler, timer, index);
+	SiftUp(scheduler, index);
+
+	return true;
+}
+
+void CancelTimer(Scheduler* scheduler, Timer* timer)
+{
+	if (!timer->slot) { return; }
+
+	int index = timer->slot - 1;
+	timer->slot = 0;
+
+	// Fill the hole with the last timer and restore heap order
+	Timer* last = scheduler->heap[--scheduler->numTimers];
+	if (last == timer) { return; }
+
+	PlaceTimer(scheduler, last, index);
+	SiftUp(scheduler, index);
+	SiftDown(scheduler, last->slot - 1);
+}
+
+bool IsTimerPending(const Timer* timer)
+{
+	return timer->slot != 0;
+}
+
+void RunScheduler(Scheduler* scheduler, Timestamp now)
+{
+	while (scheduler->numTimers > 0 && scheduler->heap[0]->due <= now)
+	{
+		// Unschedule before firing so the callback can reschedule itself
+		Timer* timer = scheduler->heap[0];
+		CancelTimer(scheduler, timer);
+		timer->proc(timer, now);
+	}
+}
+
+bool GetNextDeadline(const Scheduler* scheduler, Timestamp* due)
+{
+	if (scheduler->numTimers == 0) { return false; }
+
+	*due = scheduler->heap[0]->due;
+	return true;
+}
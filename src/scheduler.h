@@ -0,0 +1,42 @@
+#ifndef TOUCH_JOY_SCHEDULER_H
+#define TOUCH_JOY_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_TIMERS 128
+
+// Time in microseconds
+typedef uint64_t Timestamp;
+
+typedef struct Timer Timer;
+typedef void(*TimerProc)(Timer* timer, Timestamp now);
+
+// Timers are embedded in their owners so scheduling never allocates.
+// A zero-initialized timer is valid and idle.
+struct Timer
+{
+	Timestamp due;
+	TimerProc proc;
+	void* userData;
+	int slot; // Position in the heap + 1, 0 when idle
+};
+
+typedef struct
+{
+	int numTimers;
+	Timer* heap[MAX_TIMERS];
+} Scheduler;
+
+void InitScheduler(Scheduler* scheduler);
+void InitTimer(Timer* timer, TimerProc proc, void* userData);
+// Schedule or reschedule a timer
+bool ScheduleTimer(Scheduler* scheduler, Timer* timer, Timestamp due);
+void CancelTimer(Scheduler* scheduler, Timer* timer);
+bool IsTimerPending(const Timer* timer);
+// Fire all timers that are due at the given time
+void RunScheduler(Scheduler* scheduler, Timestamp now);
+// Return false when there is no pending timer
+bool GetNextDeadline(const Scheduler* scheduler, Timestamp* due);
+
+#endif
@@ -0,0 +1,254 @@
+#include <string.h>
+#include "slider.h"
+
+// One notch
+#define WHEEL_NOTCH 120
+
+void InitSlider(Slider* slider)
+{
+	memset(slider, 0, sizeof(Slider));
+	slider->numDetents = DEFAULT_SLIDER_DETENTS;
+	slider->sensitivity = 1.f;
+	InitKeyStepper(&slider->steps);
+}
+
+void LayoutSlider(Slider* slider, int length)
+{
+	int numDetents = slider->numDetents;
+	for (int i = 1; i < numDetents; ++i)
+	{
+		slider->boundaries[i - 1] = (int)((int64_t)length * 100 * i / numDetents);
+	}
+
+	if (slider->detent >= numDetents) { slider->detent = numDetents - 1; }
+}
+
+// Detents are only ever crossed a few at a time so walking from the current
+// one is cheaper than a search
+static int FindDetent(const Slider* slider, int position)
+{
+	int detent = slider->detent;
+	int lastDetent = slider->numDetents - 1;
+
+	while (detent < lastDetent && position >= slider->boundaries[detent]) { ++detent; }
+	while (detent > 0 && position < slider->boundaries[detent - 1]) { --detent; }
+
+	return detent;
+}
+
+// Output crossings to the detent under position. Motion within a detent
+// produces nothing.
+static void MoveToDetent(
+	Slider* slider, Scheduler* scheduler, Output* output, int position, Timestamp now
+)
+{
+	int detent = FindDetent(slider, position);
+	int steps = detent - slider->detent;
+	if (steps == 0) { return; }
+
+	slider->detent = detent;
+
+	if (slider->mode == SLIDER_WHEEL)
+	{
+		OutputWheel(output, steps * WHEEL_NOTCH);
+		return;
+	}
+
+	QueueKeySteps(&slider->steps, scheduler, output, slider->codes, steps, now);
+}
+
+static void MoveMouse(Slider* slider, Output* output, int position)
+{
+	float move = (float)(position - slider->lastPosition) / 100.f
+		* slider->sensitivity
+		+ slider->remainder;
+	int whole = (int)move;
+	slider->remainder = move - (float)whole;
+
+	if (whole == 0) { return; }
+
+	// Positions grow upwards on a vertical track, the screen downwards
+	if (slider->vertical)
+	{
+		OutputMouseMove(output, 0, -whole);
+	}
+	else
+	{
+		OutputMouseMove(output, whole, 0);
+	}
+}
+
+void SliderDown(
+	Slider* slider, Scheduler* scheduler, Output* output, int position, Timestamp now
+)
+{
+	slider->active = true;
+	slider->lastPosition = position;
+
+	// The knob jumps to where the track is touched
+	if (slider->mode != SLIDER_MOUSE)
+	{
+		MoveToDetent(slider, scheduler, output, position, now);
+	}
+}
+
+void SliderMove(
+	Slider* slider, Scheduler* scheduler, Output* output, int position, Timestamp now
+)
+{
+	if (!slider->active) { return; }
+
+	if (slider->mode == SLIDER_MOUSE)
+	{
+		MoveMouse(slider, output, position);
+	}
+	else
+	{
+		MoveToDetent(slider, scheduler, output, position, now);
+	}
+
+	slider->lastPosition = position;
+}
+
+void SliderUp(Slider* slider)
+{
+	slider->active = false;
+	slider->remainder = 0.f;
+}
+
+void StopSlider(Slider* slider)
+{
+	StopKeySteps(&slider->steps);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+static void RunUntil(
+	Scheduler* scheduler, Output* output, Timestamp* clock, Timestamp end
+)
+{
+	FlushOutput(output);
+
+	Timestamp due;
+	while (GetNextDeadline(scheduler, &due) && due <= end)
+	{
+		*clock = due;
+		RunScheduler(scheduler, due);
+		FlushOutput(output);
+	}
+	*clock = end;
+}
+
+TEST(slider_detents)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Slider slider;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitSlider(&slider);
+	slider.codes[SLIDER_DECREASE] = 'S';
+	slider.codes[SLIDER_INCREASE] = 'W';
+	LayoutSlider(&slider, 200);
+
+	// A slow drag over the whole track only outputs the 9 crossings
+	SliderDown(&slider, &scheduler, &output, 0, clock);
+	for (int position = 0; position <= 20000; position += 7)
+	{
+		SliderMove(&slider, &scheduler, &output, position, clock);
+		RunUntil(&scheduler, &output, &clock, clock + 1000);
+	}
+	SliderUp(&slider);
+	RunUntil(&scheduler, &output, &clock, clock + 1000000);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(9, slider.detent);
+	TEST_ASSERT_EQUAL_INT(9 * 2, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT('W', recorder.events[0].event.data.key.code);
+
+	// The knob stays where it was left and jumps to a new touch. Every step
+	// is held for a pulse and followed by as long a pause.
+	recorder.numEvents = 0;
+	Timestamp start = clock;
+	SliderDown(&slider, &scheduler, &output, 9000, clock);
+	SliderUp(&slider);
+	RunUntil(&scheduler, &output, &clock, clock + 1000000);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(4, slider.detent);
+	TEST_ASSERT_EQUAL_INT(5 * 2, recorder.numEvents);
+	for (int i = 0; i < 5 * 2; ++i)
+	{
+		const RecordedOutput* event = &recorder.events[i];
+		TEST_ASSERT_EQUAL_INT('S', event->event.data.key.code);
+		TEST_ASSERT(event->event.data.key.down == (i % 2 == 0));
+		TEST_ASSERT(event->time == start + (Timestamp)i * KEY_PULSE_LENGTH);
+	}
+
+	// Going back before the steps are done cancels those left: two of five
+	// steps up were tapped, then three down
+	recorder.numEvents = 0;
+	SliderDown(&slider, &scheduler, &output, 20000, clock);
+	RunUntil(&scheduler, &output, &clock, clock + KEY_PULSE_LENGTH * 2);
+	SliderMove(&slider, &scheduler, &output, 7000, clock);
+	SliderUp(&slider);
+	RunUntil(&scheduler, &output, &clock, clock + 1000000);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(3, slider.detent);
+	TEST_ASSERT_EQUAL_INT(5 * 2, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT('W', recorder.events[2].event.data.key.code);
+	TEST_ASSERT_EQUAL_INT('S', recorder.events[4].event.data.key.code);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+
+	// Jitter around a boundary within a detent produces nothing
+	recorder.numEvents = 0;
+	SliderDown(&slider, &scheduler, &output, 7990, clock);
+	SliderMove(&slider, &scheduler, &output, 6010, clock);
+	SliderMove(&slider, &scheduler, &output, 7990, clock);
+	SliderUp(&slider);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(0, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+
+	// Stopping releases the key of the step in progress
+	SliderDown(&slider, &scheduler, &output, 0, clock);
+	StopSlider(&slider);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(2, recorder.numEvents);
+	TEST_ASSERT(!recorder.events[1].event.data.key.down);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+
+	// A fast flick in wheel mode scrolls all crossed notches in one event
+	recorder.numEvents = 0;
+	slider.mode = SLIDER_WHEEL;
+	slider.detent = 4;
+	SliderDown(&slider, &scheduler, &output, 9000, clock);
+	SliderMove(&slider, &scheduler, &output, 500, clock);
+	SliderUp(&slider);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(1, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(-4 * 120, recorder.events[0].event.data.wheel.delta);
+	TEST_ASSERT_EQUAL_INT(0, slider.detent);
+
+	// Mouse mode carries fractions of a pixel
+	recorder.numEvents = 0;
+	slider.mode = SLIDER_MOUSE;
+	slider.vertical = true;
+	slider.sensitivity = 0.5f;
+	SliderDown(&slider, &scheduler, &output, 0, clock);
+	for (int i = 1; i <= 40; ++i)
+	{
+		SliderMove(&slider, &scheduler, &output, i * 50, clock);
+	}
+	SliderUp(&slider);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(1, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(0, recorder.events[0].event.data.move.dx);
+	TEST_ASSERT_EQUAL_INT(-10, recorder.events[0].event.data.move.dy);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TOUCH_JOY_SLIDER_H
+#define TOUCH_JOY_SLIDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+#include "stepper.h"
+
+#define MAX_SLIDER_DETENTS 64
+#define DEFAULT_SLIDER_DETENTS 10
+
+typedef enum
+{
+	// Tap a key for every detent crossed, one after the other
+	SLIDER_STEPS,
+	// Scroll one notch for every detent crossed
+	SLIDER_WHEEL,
+	// Move the mouse along the track
+	SLIDER_MOUSE
+} SliderMode;
+
+enum
+{
+	SLIDER_DECREASE = STEP_DECREASE,
+	SLIDER_INCREASE = STEP_INCREASE
+};
+
+// A one-dimensional control which keeps its position when released, like a
+// throttle.
+// Positions are in hundredths of a pixel from the low end of the track.
+typedef struct
+{
+	SliderMode mode;
+	bool vertical;
+	int numDetents;
+	uint16_t codes[2];
+	float sensitivity;
+
+	// Start of each detent but the first, built by LayoutSlider
+	int boundaries[MAX_SLIDER_DETENTS - 1];
+	int detent;
+	bool active;
+	int lastPosition;
+	// Fraction of a pixel which has not been output yet
+	float remainder;
+	KeyStepper steps;
+} Slider;
+
+void InitSlider(Slider* slider);
+// Divide a track of the given length in pixels into equal detents
+void LayoutSlider(Slider* slider, int length);
+void SliderDown(
+	Slider* slider, Scheduler* scheduler, Output* output, int position, Timestamp now
+);
+void SliderMove(
+	Slider* slider, Scheduler* scheduler, Output* output, int position, Timestamp now
+);
+// Steps still being tapped carry on after the finger lifts
+void SliderUp(Slider* slider);
+void StopSlider(Slider* slider);
+
+#endif
@@ -0,0 +1,68 @@
+#include <string.h>
+#include "stepper.h"
+
+static void TapNextStep(KeyStepper* stepper, Timestamp now)
+{
+	if (stepper->pending == 0) { return; }
+
+	int direction = stepper->pending > 0 ? STEP_INCREASE : STEP_DECREASE;
+	stepper->pending += direction == STEP_INCREASE ? -1 : 1;
+	stepper->held = stepper->codes[direction];
+	OutputKey(stepper->output, stepper->held, true);
+	ScheduleTimer(stepper->scheduler, &stepper->timer, now + KEY_PULSE_LENGTH);
+}
+
+static void OnStepTimer(Timer* timer, Timestamp now)
+{
+	KeyStepper* stepper = (KeyStepper*)timer->userData;
+
+	if (!stepper->held)
+	{
+		TapNextStep(stepper, now);
+		return;
+	}
+
+	OutputKey(stepper->output, stepper->held, false);
+	stepper->held = 0;
+	// The key stays up for a pulse too, or the next tap would merge with it
+	if (stepper->pending != 0)
+	{
+		ScheduleTimer(stepper->scheduler, timer, now + KEY_PULSE_LENGTH);
+	}
+}
+
+void InitKeyStepper(KeyStepper* stepper)
+{
+	memset(stepper, 0, sizeof(KeyStepper));
+}
+
+void QueueKeySteps(
+	KeyStepper* stepper,
+	Scheduler* scheduler,
+	Output* output,
+	const uint16_t codes[2],
+	int steps,
+	Timestamp now
+)
+{
+	stepper->codes[STEP_DECREASE] = codes[STEP_DECREASE];
+	stepper->codes[STEP_INCREASE] = codes[STEP_INCREASE];
+	stepper->pending += steps;
+
+	// A tap or the pause after it is in progress, the timer continues
+	if (stepper->scheduler && IsTimerPending(&stepper->timer)) { return; }
+
+	InitTimer(&stepper->timer, &OnStepTimer, stepper);
+	stepper->scheduler = scheduler;
+	stepper->output = output;
+	TapNextStep(stepper, now);
+}
+
+void StopKeySteps(KeyStepper* stepper)
+{
+	if (stepper->scheduler) { CancelTimer(stepper->scheduler, &stepper->timer); }
+	if (stepper->held) { OutputKey(stepper->output, stepper->held, false); }
+
+	stepper->held = 0;
+	stepper->pending = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef TOUCH_JOY_STEPPER_H
+#define TOUCH_JOY_STEPPER_H
+
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+enum
+{
+	STEP_DECREASE,
+	STEP_INCREASE
+};
+
+// Taps a key for every step of a detented control, one step at a time: held
+// for KEY_PULSE_LENGTH, then left up as long. Steps queued in opposite
+// directions cancel out.
+typedef struct
+{
+	uint16_t codes[2];
+	// Steps not tapped yet, negative to decrease
+	int pending;
+	// Key being held, 0 between taps
+	uint16_t held;
+
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+} KeyStepper;
+
+void InitKeyStepper(KeyStepper* stepper);
+void QueueKeySteps(
+	KeyStepper* stepper,
+	Scheduler* scheduler,
+	Output* output,
+	const uint16_t codes[2],
+	int steps,
+	Timestamp now
+);
+// Drop the steps left and release the key being held
+void StopKeySteps(KeyStepper* stepper);
+
+#endif
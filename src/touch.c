@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include "touch.h"
+
+void InitTouchBuffer(TouchBuffer* buffer, size_t itemSize)
+{
+	buffer->items = NULL;
+	buffer->capacity = 0;
+	buffer->itemSize = itemSize;
+}
+
+int ReserveTouchBuffer(TouchBuffer* buffer, int count)
+{
+	if (count <= buffer->capacity) { return count; }
+
+	void* items = realloc(buffer->items, (size_t)count * buffer->itemSize);
+	if (!items) { return buffer->capacity; }
+
+	buffer->items = items;
+	buffer->capacity = count;
+	return count;
+}
+
+void FreeTouchBuffer(TouchBuffer* buffer)
+{
+	free(buffer->items);
+	InitTouchBuffer(buffer, buffer->itemSize);
+}
+
+bool RouteContact(TouchCapture* capture, uint32_t id, TouchEvent* event)
+{
+	if (capture->active)
+	{
+		if (capture->id != id) { return false; }
+
+		// A repeated down for the same contact is a move
+		if (*event == TOUCH_DOWN) { *event = TOUCH_MOVE; }
+		if (*event == TOUCH_UP) { capture->active = false; }
+
+		return true;
+	}
+
+	// Lifting a contact which never drove the control means nothing
+	if (*event == TOUCH_UP) { return false; }
+
+	capture->active = true;
+	capture->id = id;
+	*event = TOUCH_DOWN;
+
+	return true;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+typedef struct
+{
+	uint32_t id;
+	TouchEvent event;
+} TouchInput;
+
+typedef struct
+{
+	int numEvents;
+	uint32_t ids[32];
+	TouchEvent events[32];
+} RoutedLog;
+
+static void RouteBatch(
+	TouchCapture* capture, const TouchInput* batch, int numInputs, RoutedLog* log
+)
+{
+	for (int i = 0; i < numInputs; ++i)
+	{
+		TouchEvent event = batch[i].event;
+		if (RouteContact(capture, batch[i].id, &event))
+		{
+			log->ids[log->numEvents] = batch[i].id;
+			log->events[log->numEvents] = event;
+			++log->numEvents;
+		}
+	}
+}
+
+TEST(touch_contacts)
+{
+	TouchCapture capture = { false, 0 };
+	RoutedLog log = { 0 };
+
+	// A second finger lands on a stick which is already held
+	TouchInput batch1[] = { { 1, TOUCH_DOWN } };
+	TouchInput batch2[] = { { 1, TOUCH_MOVE }, { 2, TOUCH_DOWN } };
+	// The first finger lifts while the second one moves, in the same batch
+	// and after it
+	TouchInput batch3[] = { { 2, TOUCH_MOVE }, { 1, TOUCH_UP } };
+	// The second finger takes over, then lifts along with a stray contact
+	TouchInput batch4[] = { { 2, TOUCH_MOVE }, { 3, TOUCH_UP }, { 2, TOUCH_UP } };
+
+	RouteBatch(&capture, batch1, 1, &log);
+	RouteBatch(&capture, batch2, 2, &log);
+	RouteBatch(&capture, batch3, 2, &log);
+	RouteBatch(&capture, batch4, 3, &log);
+
+	TEST_ASSERT_EQUAL_INT(5, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(1, log.ids[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[1]);
+	// The release is not lost behind the other finger's move
+	TEST_ASSERT_EQUAL_INT(1, log.ids[2]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[2]);
+	TEST_ASSERT_EQUAL_INT(2, log.ids[3]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[3]);
+	TEST_ASSERT_EQUAL_INT(2, log.ids[4]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[4]);
+	TEST_ASSERT(!capture.active);
+
+	// A message with more inputs than usual, the release of the finger on
+	// the control comes last
+	TouchBuffer buffer;
+	InitTouchBuffer(&buffer, sizeof(TouchInput));
+	TEST_ASSERT_EQUAL_INT(8, ReserveTouchBuffer(&buffer, 8));
+	const int numInputs = 40;
+	TEST_ASSERT_EQUAL_INT(numInputs, ReserveTouchBuffer(&buffer, numInputs));
+	TEST_ASSERT_EQUAL_INT(numInputs, buffer.capacity);
+	// Smaller messages reuse the room
+	TEST_ASSERT_EQUAL_INT(10, ReserveTouchBuffer(&buffer, 10));
+	TEST_ASSERT_EQUAL_INT(numInputs, buffer.capacity);
+
+	TouchInput* inputs = (TouchInput*)buffer.items;
+	for (int i = 0; i < numInputs - 1; ++i)
+	{
+		inputs[i].id = 100 + i;
+		inputs[i].event = TOUCH_MOVE;
+	}
+	inputs[numInputs - 1].id = 4;
+	inputs[numInputs - 1].event = TOUCH_UP;
+
+	log.numEvents = 0;
+	TouchInput press = { 4, TOUCH_DOWN };
+	RouteBatch(&capture, &press, 1, &log);
+	RouteBatch(&capture, inputs, numInputs, &log);
+	TEST_ASSERT_EQUAL_INT(2, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[1]);
+	TEST_ASSERT(!capture.active);
+
+	FreeTouchBuffer(&buffer);
+	TEST_ASSERT(buffer.items == NULL && buffer.capacity == 0);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TOUCH_JOY_TOUCH_H
+#define TOUCH_JOY_TOUCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+typedef enum
+{
+	TOUCH_DOWN,
+	TOUCH_UP,
+	TOUCH_MOVE
+} TouchEvent;
+
+// A contact event from any touch source: WM_TOUCH, an evdev device or a
+// recorded stream. Coordinates are in hundredths of a screen pixel, like
+// TOUCHINPUT. Controls and handlers taking touch positions use this unit
+// unless they say otherwise.
+typedef struct
+{
+	uint32_t id;
+	TouchEvent event;
+	int x;
+	int y;
+	Timestamp time;
+} TouchPoint;
+
+// Receives the contacts of a touch source
+typedef void(*TouchProc)(void* userData, const TouchPoint* point);
+
+// Storage for the inputs of one touch message. Messages can carry any
+// number of inputs and dropping one could lose a release, so it grows to
+// hold the largest message seen. It is only reallocated when a message is
+// larger than all previous ones.
+typedef struct
+{
+	void* items;
+	int capacity;
+	size_t itemSize;
+} TouchBuffer;
+
+void InitTouchBuffer(TouchBuffer* buffer, size_t itemSize);
+// Make room for count items, keeping the previous room if memory runs out.
+// Return the number of items which fit.
+int ReserveTouchBuffer(TouchBuffer* buffer, int count);
+void FreeTouchBuffer(TouchBuffer* buffer);
+
+// The contact driving a control which follows one finger at a time
+typedef struct
+{
+	bool active;
+	uint32_t id;
+} TouchCapture;
+
+// Decide whether an event of contact id applies to a control.
+//
+// The first contact down captures the control until it lifts, other
+// contacts are ignored meanwhile. A contact still on the control when the
+// capture ends takes over on its next move, which is reported as a down.
+bool RouteContact(TouchCapture* capture, uint32_t id, TouchEvent* event);
+
+#endif
@@ -0,0 +1,247 @@
+#include <math.h>
+#include <string.h>
+#include "trackball.h"
+
+// A finger resting this long before lifting does not flick
+#define FLICK_TIMEOUT 50000
+// Pixels per step below which the ball stops
+#define MIN_ROLL_SPEED 0.05f
+// How much of the previous velocity is kept when a move comes in
+#define VELOCITY_SMOOTHING 0.4f
+
+static void OutputRoll(Trackball* trackball, Output* output, float dx, float dy)
+{
+	float moveX = dx + trackball->remainderX;
+	float moveY = dy + trackball->remainderY;
+
+	// Only whole pixels can be injected, carry the rest to the next event
+	int wholeX = (int)moveX;
+	int wholeY = (int)moveY;
+	trackball->remainderX = moveX - (float)wholeX;
+	trackball->remainderY = moveY - (float)wholeY;
+
+	if (wholeX != 0 || wholeY != 0) { OutputMouseMove(output, wholeX, wholeY); }
+}
+
+static bool IsFastEnough(const Trackball* trackball)
+{
+	return fabsf(trackball->velocityX) >= MIN_ROLL_SPEED
+		|| fabsf(trackball->velocityY) >= MIN_ROLL_SPEED;
+}
+
+static void OnTrackballTimer(Timer* timer, Timestamp now)
+{
+	Trackball* trackball = (Trackball*)timer->userData;
+
+	// Steps missed by a late wakeup are run now so that the path only
+	// depends on the number of steps, never on when they ran
+	while (trackball->nextStep <= now)
+	{
+		OutputRoll(
+			trackball, trackball->output, trackball->velocityX, trackball->velocityY
+		);
+		trackball->velocityX *= trackball->decay;
+		trackball->velocityY *= trackball->decay;
+		trackball->nextStep += TRACKBALL_STEP;
+
+		if (!IsFastEnough(trackball))
+		{
+			trackball->velocityX = 0.f;
+			trackball->velocityY = 0.f;
+			return;
+		}
+	}
+
+	ScheduleTimer(trackball->scheduler, &trackball->timer, trackball->nextStep);
+}
+
+void InitTrackball(Trackball* trackball)
+{
+	memset(trackball, 0, sizeof(Trackball));
+	trackball->sensitivity = 1.f;
+	SetTrackballFriction(trackball, DEFAULT_TRACKBALL_FRICTION);
+}
+
+void SetTrackballFriction(Trackball* trackball, int friction)
+{
+	float keptPerSecond = 1.f - (float)friction / 100.f;
+	trackball->decay = powf(keptPerSecond, (float)TRACKBALL_STEP / 1000000.f);
+}
+
+void StopTrackball(Trackball* trackball)
+{
+	if (trackball->scheduler)
+	{
+		CancelTimer(trackball->scheduler, &trackball->timer);
+	}
+
+	trackball->velocityX = 0.f;
+	trackball->velocityY = 0.f;
+}
+
+bool IsTrackballRolling(const Trackball* trackball)
+{
+	return trackball->scheduler && IsTimerPending(&trackball->timer);
+}
+
+void TrackballDown(Trackball* trackball, int x, int y, Timestamp now)
+{
+	// Touching the ball stops it
+	StopTrackball(trackball);
+
+	trackball->touching = true;
+	trackball->lastX = x;
+	trackball->lastY = y;
+	trackball->lastTime = now;
+	trackball->remainderX = 0.f;
+	trackball->remainderY = 0.f;
+}
+
+void TrackballMove(
+	Trackball* trackball, Output* output, int x, int y, Timestamp now
+)
+{
+	if (!trackball->touching) { return; }
+
+	float dx = (float)(x - trackball->lastX) / 100.f * trackball->sensitivity;
+	float dy = (float)(y - trackball->lastY) / 100.f * trackball->sensitivity;
+	trackball->lastX = x;
+	trackball->lastY = y;
+
+	OutputRoll(trackball, output, dx, dy);
+
+	// Several moves can arrive with the same timestamp, keep the last
+	// velocity for those
+	if (now > trackball->lastTime)
+	{
+		float steps = (float)(now - trackball->lastTime) / (float)TRACKBALL_STEP;
+		trackball->velocityX = trackball->velocityX * VELOCITY_SMOOTHING
+			+ dx / steps * (1.f - VELOCITY_SMOOTHING);
+		trackball->velocityY = trackball->velocityY * VELOCITY_SMOOTHING
+			+ dy / steps * (1.f - VELOCITY_SMOOTHING);
+		trackball->lastTime = now;
+	}
+}
+
+void TrackballUp(
+	Trackball* trackball, Scheduler* scheduler, Output* output, Timestamp now
+)
+{
+	if (!trackball->touching) { return; }
+	trackball->touching = false;
+
+	if (now - trackball->lastTime > FLICK_TIMEOUT || !IsFastEnough(trackball))
+	{
+		trackball->velocityX = 0.f;
+		trackball->velocityY = 0.f;
+		return;
+	}
+
+	InitTimer(&trackball->timer, &OnTrackballTimer, trackball);
+	trackball->scheduler = scheduler;
+	trackball->output = output;
+	trackball->nextStep = now + TRACKBALL_STEP;
+	ScheduleTimer(scheduler, &trackball->timer, trackball->nextStep);
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+typedef struct
+{
+	int x;
+	int y;
+	int numSteps;
+} RollResult;
+
+// Flick to the right and down, then let the ball roll out waking up late
+// by a pseudo random amount seeded with jitterSeed (0 for no jitter)
+static RollResult ReplayFlick(uint32_t jitterSeed)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Trackball trackball;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitTrackball(&trackball);
+
+	// 8 moves of 10 by 5 pixels every 8ms
+	TrackballDown(&trackball, 0, 0, clock);
+	for (int i = 1; i <= 8; ++i)
+	{
+		clock += 8000;
+		TrackballMove(&trackball, &output, i * 1000, i * 500, clock);
+	}
+	TrackballUp(&trackball, &scheduler, &output, clock);
+
+	RollResult result = { 0, 0, 0 };
+	Timestamp due;
+	uint32_t seed = jitterSeed;
+	while (GetNextDeadline(&scheduler, &due))
+	{
+		if (jitterSeed)
+		{
+			seed = seed * 1103515245u + 12345u;
+			due += (seed >> 16) % 10000;
+		}
+		clock = due;
+		RunScheduler(&scheduler, clock);
+		++result.numSteps;
+	}
+	FlushOutput(&output);
+
+	for (int i = 0; i < recorder.numEvents; ++i)
+	{
+		result.x += recorder.events[i].event.data.move.dx;
+		result.y += recorder.events[i].event.data.move.dy;
+	}
+
+	return result;
+}
+
+TEST(trackball_inertia)
+{
+	RollResult steady = ReplayFlick(0);
+	RollResult jittery = ReplayFlick(7);
+
+	// The path does not depend on when the scheduler wakes up
+	TEST_ASSERT_EQUAL_INT(steady.x, jittery.x);
+	TEST_ASSERT_EQUAL_INT(steady.y, jittery.y);
+	TEST_ASSERT(jittery.numSteps < steady.numSteps);
+
+	// Reference: the finger moved 10 by 5 pixels per 2 steps and the ball
+	// keeps that speed, losing 90% of it every second
+	double decay = pow(0.1, TRACKBALL_STEP / 1000000.0);
+	double speed = 5.0;
+	double rolled = 0.0;
+	while (speed >= MIN_ROLL_SPEED)
+	{
+		rolled += speed;
+		speed *= decay;
+	}
+	double expectedX = 80.0 + rolled;
+	TEST_ASSERT(fabs(steady.x - expectedX) <= 2.0);
+	TEST_ASSERT(fabs(steady.y - expectedX / 2.0) <= 2.0);
+
+	// A finger which stops before lifting does not flick
+	Scheduler scheduler;
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Output output;
+	Trackball trackball;
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitTrackball(&trackball);
+	TrackballDown(&trackball, 0, 0, 0);
+	TrackballMove(&trackball, &output, 1000, 0, 8000);
+	TrackballUp(&trackball, &scheduler, &output, 100000);
+	TEST_ASSERT(!IsTrackballRolling(&trackball));
+}
+
+#endif
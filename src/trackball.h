@@ -0,0 +1,50 @@
+#ifndef TOUCH_JOY_TRACKBALL_H
+#define TOUCH_JOY_TRACKBALL_H
+
+#include <stdbool.h>
+#include "output.h"
+#include "scheduler.h"
+
+// Inertia is simulated in fixed steps of this many microseconds
+#define TRACKBALL_STEP 4000
+#define DEFAULT_TRACKBALL_FRICTION 90
+
+// A trackpad which keeps rolling after a flick.
+typedef struct
+{
+	float sensitivity;
+	// Fraction of the speed kept after each step
+	float decay;
+
+	bool touching;
+	int lastX;
+	int lastY;
+	Timestamp lastTime;
+	// Smoothed finger velocity in pixels per step
+	float velocityX;
+	float velocityY;
+	// Sub-pixel motion which has not been output yet
+	float remainderX;
+	float remainderY;
+
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	Timestamp nextStep;
+} Trackball;
+
+void InitTrackball(Trackball* trackball);
+// Percentage of the speed lost every second
+void SetTrackballFriction(Trackball* trackball, int friction);
+void TrackballDown(Trackball* trackball, int x, int y, Timestamp now);
+void TrackballMove(
+	Trackball* trackball, Output* output, int x, int y, Timestamp now
+);
+// Start rolling with the speed of the finger
+void TrackballUp(
+	Trackball* trackball, Scheduler* scheduler, Output* output, Timestamp now
+);
+void StopTrackball(Trackball* trackball);
+bool IsTrackballRolling(const Trackball* trackball);
+
+#endif
@@ -0,0 +1,355 @@
+#include <stddef.h>
+#include "tracker.h"
+
+void InitTracker(TouchTracker* tracker, TrackerProc proc, void* userData)
+{
+	tracker->numTargets = 0;
+	tracker->numContacts = 0;
+	tracker->proc = proc;
+	tracker->userData = userData;
+	tracker->indexed = false;
+	tracker->coalescedMoves = 0;
+	tracker->staleBatches = 0;
+	InitGrid(
+		&tracker->index,
+		tracker->cellStarts,
+		MAX_TRACKER_CELLS,
+		tracker->cellItems,
+		MAX_TRACKER_CELL_ITEMS
+	);
+}
+
+int AddTrackerTarget(
+	TouchTracker* tracker, int x, int y, int width, int height, int flags
+)
+{
+	if (tracker->numTargets == MAX_TRACKER_TARGETS) { return -1; }
+
+	int target = tracker->numTargets++;
+	tracker->flags[target] = flags;
+	MoveTrackerTarget(tracker, target, x, y, width, height);
+
+	return target;
+}
+
+void MoveTrackerTarget(
+	TouchTracker* tracker, int target, int x, int y, int width, int height
+)
+{
+	GridRect* bounds = &tracker->bounds[target];
+	bounds->left = x;
+	bounds->top = y;
+	bounds->right = x + width;
+	bounds->bottom = y + height;
+
+	tracker->indexed = false;
+}
+
+int HitTest(TouchTracker* tracker, int x, int y)
+{
+	// There are always more cell entries than targets so this cannot fail
+	if (!tracker->indexed)
+	{
+		BuildGrid(&tracker->index, tracker->bounds, tracker->numTargets);
+		tracker->indexed = true;
+	}
+
+	return QueryGrid(&tracker->index, x, y);
+}
+
+static void Emit(
+	TouchTracker* tracker, int target, uint32_t id, TouchEvent event, int x, int y
+)
+{
+	tracker->proc(tracker->userData, target, id, event, x, y);
+}
+
+// Pass a move or lift to the target the contact is over, releasing the one
+// it slid off
+static void Slide(
+	TouchTracker* tracker, TrackedContact* contact, TouchEvent event, int x, int y
+)
+{
+	int target = contact->target;
+	if (target >= 0 && (tracker->flags[target] & TARGET_FOLLOW))
+	{
+		Emit(tracker, target, contact->id, event, x, y);
+		return;
+	}
+
+	int hit = HitTest(tracker, x, y);
+	if (hit == target)
+	{
+		if (target >= 0) { Emit(tracker, target, contact->id, event, x, y); }
+		return;
+	}
+
+	if (target >= 0) { Emit(tracker, target, contact->id, TOUCH_UP, x, y); }
+
+	// Lifting off right after sliding in is not a tap
+	contact->target = -1;
+	if (event == TOUCH_UP) { return; }
+
+	if (hit >= 0 && (tracker->flags[hit] & TARGET_SLIDE_IN))
+	{
+		contact->target = hit;
+		Emit(tracker, hit, contact->id, TOUCH_DOWN, x, y);
+	}
+}
+
+static TrackedContact* FindContact(TouchTracker* tracker, uint32_t id)
+{
+	for (int i = 0; i < tracker->numContacts; ++i)
+	{
+		if (tracker->contacts[i].id == id) { return &tracker->contacts[i]; }
+	}
+
+	return NULL;
+}
+
+void TrackContact(
+	TouchTracker* tracker, uint32_t id, TouchEvent event, int x, int y
+)
+{
+	TrackedContact* contact = FindContact(tracker, id);
+	if (!contact)
+	{
+		// Lifting an unknown contact means nothing. Moves of a contact
+		// which landed before the tracker knew of it start tracking it.
+		if (event == TOUCH_UP) { return; }
+		if (tracker->numContacts == MAX_TRACKED_CONTACTS) { return; }
+
+		contact = &tracker->contacts[tracker->numContacts++];
+		contact->id = id;
+		contact->moved = false;
+		contact->target = HitTest(tracker, x, y);
+		if (contact->target >= 0)
+		{
+			Emit(tracker, contact->target, id, TOUCH_DOWN, x, y);
+		}
+
+		return;
+	}
+
+	if (contact->moved)
+	{
+		contact->moved = false;
+		// The target sees where the contact went before it lifts, while
+		// other events carry a newer position than the deferred move
+		if (event == TOUCH_UP)
+		{
+			Slide(tracker, contact, TOUCH_MOVE, contact->movedX, contact->movedY);
+		}
+		else
+		{
+			++tracker->coalescedMoves;
+		}
+	}
+
+	// A repeated down for the same contact is a move
+	Slide(tracker, contact, event == TOUCH_UP ? TOUCH_UP : TOUCH_MOVE, x, y);
+
+	if (event == TOUCH_UP)
+	{
+		*contact = tracker->contacts[--tracker->numContacts];
+	}
+}
+
+void DeferMove(TouchTracker* tracker, uint32_t id, int x, int y)
+{
+	TrackedContact* contact = FindContact(tracker, id);
+	if (!contact)
+	{
+		TrackContact(tracker, id, TOUCH_MOVE, x, y);
+		return;
+	}
+
+	if (contact->moved) { ++tracker->coalescedMoves; }
+
+	contact->moved = true;
+	contact->movedX = x;
+	contact->movedY = y;
+}
+
+void ApplyDeferredMoves(TouchTracker* tracker)
+{
+	for (int i = 0; i < tracker->numContacts; ++i)
+	{
+		TrackedContact* contact = &tracker->contacts[i];
+		if (!contact->moved) { continue; }
+
+		contact->moved = false;
+		Slide(tracker, contact, TOUCH_MOVE, contact->movedX, contact->movedY);
+	}
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+typedef struct
+{
+	int numEvents;
+	int targets[32];
+	uint32_t ids[32];
+	TouchEvent events[32];
+	int xs[32];
+} TrackerLog;
+
+static void LogContact(
+	void* userData, int target, uint32_t id, TouchEvent event, int x, int y
+)
+{
+	(void)y;
+
+	TrackerLog* log = (TrackerLog*)userData;
+	log->xs[log->numEvents] = x;
+	log->targets[log->numEvents] = target;
+	log->ids[log->numEvents] = id;
+	log->events[log->numEvents] = event;
+	++log->numEvents;
+}
+
+TEST(tracker_slide)
+{
+	TouchTracker tracker;
+	TrackerLog log = { 0 };
+	InitTracker(&tracker, &LogContact, &log);
+
+	// Two face buttons side by side, a third one pressed by sliding in and
+	// a stick. Coordinates are in hundredths of a pixel.
+	int a = AddTrackerTarget(&tracker, 0, 0, 10000, 10000, 0);
+	int b = AddTrackerTarget(&tracker, 10000, 0, 10000, 10000, TARGET_SLIDE_IN);
+	int c = AddTrackerTarget(&tracker, 20000, 0, 10000, 10000, 0);
+	int stick = AddTrackerTarget(&tracker, 0, 20000, 20000, 20000, TARGET_FOLLOW);
+	// Empty targets stand for buttons without a window
+	AddTrackerTarget(&tracker, 0, 0, 0, 0, 0);
+
+	TEST_ASSERT_EQUAL_INT(a, HitTest(&tracker, 9999, 0));
+	TEST_ASSERT_EQUAL_INT(b, HitTest(&tracker, 10000, 0));
+	TEST_ASSERT_EQUAL_INT(c, HitTest(&tracker, 29999, 9999));
+	TEST_ASSERT_EQUAL_INT(-1, HitTest(&tracker, 30000, 0));
+
+	// Rolling from a onto b releases a then presses b
+	TrackContact(&tracker, 1, TOUCH_DOWN, 5000, 5000);
+	TrackContact(&tracker, 1, TOUCH_MOVE, 8000, 5000);
+	TrackContact(&tracker, 1, TOUCH_MOVE, 15000, 5000);
+	TEST_ASSERT_EQUAL_INT(4, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[1]);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[2]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[2]);
+	TEST_ASSERT_EQUAL_INT(b, log.targets[3]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[3]);
+
+	// c does not take slide ins so moving on to it only releases b, and
+	// sliding back onto b presses it again
+	TrackContact(&tracker, 1, TOUCH_MOVE, 25000, 5000);
+	TrackContact(&tracker, 1, TOUCH_MOVE, 26000, 5000);
+	TrackContact(&tracker, 1, TOUCH_MOVE, 15000, 5000);
+	TrackContact(&tracker, 1, TOUCH_UP, 15000, 5000);
+	TEST_ASSERT_EQUAL_INT(7, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(b, log.targets[4]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[4]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[5]);
+	TEST_ASSERT_EQUAL_INT(b, log.targets[6]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[6]);
+	TEST_ASSERT_EQUAL_INT(0, tracker.numContacts);
+
+	// The stick keeps its finger when dragged off, while a second finger
+	// lands on a and lifts there
+	log.numEvents = 0;
+	TrackContact(&tracker, 2, TOUCH_DOWN, 10000, 30000);
+	TrackContact(&tracker, 3, TOUCH_DOWN, 5000, 5000);
+	TrackContact(&tracker, 2, TOUCH_MOVE, 5000, 5000);
+	TrackContact(&tracker, 3, TOUCH_UP, 5000, 5000);
+	TrackContact(&tracker, 2, TOUCH_UP, 50000, 50000);
+	TEST_ASSERT_EQUAL_INT(5, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(stick, log.targets[0]);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[1]);
+	TEST_ASSERT_EQUAL_INT(stick, log.targets[2]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[2]);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[3]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[3]);
+	TEST_ASSERT_EQUAL_INT(stick, log.targets[4]);
+	TEST_ASSERT_EQUAL_INT(2, log.ids[4]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[4]);
+
+	// Contacts landing on nothing are tracked and may slide onto b, but
+	// lifting on a from b only releases b
+	log.numEvents = 0;
+	TrackContact(&tracker, 4, TOUCH_DOWN, 35000, 5000);
+	TrackContact(&tracker, 4, TOUCH_MOVE, 15000, 5000);
+	TrackContact(&tracker, 5, TOUCH_UP, 0, 0);
+	TrackContact(&tracker, 4, TOUCH_UP, 5000, 5000);
+	TEST_ASSERT_EQUAL_INT(2, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(b, log.targets[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[0]);
+	TEST_ASSERT_EQUAL_INT(b, log.targets[1]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[1]);
+	TEST_ASSERT_EQUAL_INT(0, tracker.numContacts);
+
+	// Moved targets are hit at their new place
+	MoveTrackerTarget(&tracker, c, 40000, 0, 10000, 10000);
+	TEST_ASSERT_EQUAL_INT(-1, HitTest(&tracker, 25000, 5000));
+	TEST_ASSERT_EQUAL_INT(c, HitTest(&tracker, 45000, 5000));
+}
+
+TEST(tracker_coalesce)
+{
+	TouchTracker tracker;
+	TrackerLog log = { 0 };
+	InitTracker(&tracker, &LogContact, &log);
+
+	int a = AddTrackerTarget(&tracker, 0, 0, 10000, 10000, 0);
+	AddTrackerTarget(&tracker, 10000, 0, 10000, 10000, TARGET_SLIDE_IN);
+	int stick = AddTrackerTarget(&tracker, 0, 20000, 20000, 20000, TARGET_FOLLOW);
+
+	// A backlog of moves on a stick only outputs the latest position, while
+	// another finger's tap in the middle of it is kept
+	TrackContact(&tracker, 1, TOUCH_DOWN, 10000, 30000);
+	DeferMove(&tracker, 1, 11000, 30000);
+	DeferMove(&tracker, 1, 12000, 30000);
+	TrackContact(&tracker, 2, TOUCH_DOWN, 5000, 5000);
+	TrackContact(&tracker, 2, TOUCH_UP, 5000, 5000);
+	DeferMove(&tracker, 1, 13000, 30000);
+	TEST_ASSERT_EQUAL_INT(3, log.numEvents);
+	ApplyDeferredMoves(&tracker);
+	ApplyDeferredMoves(&tracker);
+
+	TEST_ASSERT_EQUAL_INT(4, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(stick, log.targets[0]);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[1]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_DOWN, log.events[1]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[2]);
+	TEST_ASSERT_EQUAL_INT(stick, log.targets[3]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[3]);
+	TEST_ASSERT_EQUAL_INT(13000, log.xs[3]);
+	TEST_ASSERT_EQUAL_INT(2, (int)tracker.coalescedMoves);
+
+	// A lift applies the deferred move before releasing
+	log.numEvents = 0;
+	DeferMove(&tracker, 1, 14000, 30000);
+	TrackContact(&tracker, 1, TOUCH_UP, 15000, 30000);
+	ApplyDeferredMoves(&tracker);
+	TEST_ASSERT_EQUAL_INT(2, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[0]);
+	TEST_ASSERT_EQUAL_INT(14000, log.xs[0]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_UP, log.events[1]);
+	TEST_ASSERT_EQUAL_INT(15000, log.xs[1]);
+	TEST_ASSERT_EQUAL_INT(2, (int)tracker.coalescedMoves);
+
+	// Slides are decided on the latest position: a stale trip from a over b
+	// and back to a keeps a pressed
+	log.numEvents = 0;
+	TrackContact(&tracker, 3, TOUCH_DOWN, 5000, 5000);
+	DeferMove(&tracker, 3, 15000, 5000);
+	DeferMove(&tracker, 3, 6000, 5000);
+	ApplyDeferredMoves(&tracker);
+	TEST_ASSERT_EQUAL_INT(2, log.numEvents);
+	TEST_ASSERT_EQUAL_INT(a, log.targets[1]);
+	TEST_ASSERT_EQUAL_INT(TOUCH_MOVE, log.events[1]);
+}
+
+#endif
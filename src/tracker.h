@@ -0,0 +1,84 @@
+#ifndef TOUCH_JOY_TRACKER_H
+#define TOUCH_JOY_TRACKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "grid.h"
+#include "touch.h"
+
+#define MAX_TRACKER_TARGETS 32
+#define MAX_TRACKED_CONTACTS 32
+#define MAX_TRACKER_CELLS 256
+#define MAX_TRACKER_CELL_ITEMS 256
+
+typedef enum
+{
+	// Keeps the contacts which land on it wherever they move, like a stick
+	TARGET_FOLLOW = 1,
+	// Pressed by contacts sliding onto it, not only by those landing on it
+	TARGET_SLIDE_IN = 2
+} TargetFlags;
+
+typedef struct
+{
+	uint32_t id;
+	// -1 while the contact is over no target
+	int target;
+	// Latest deferred move, applied by ApplyDeferredMoves
+	bool moved;
+	int movedX;
+	int movedY;
+} TrackedContact;
+
+// Receives the events of a contact on the target it is over
+typedef void(*TrackerProc)(
+	void* userData, int target, uint32_t id, TouchEvent event, int x, int y
+);
+
+// Owns every contact on the gamepad so that a finger sliding from one
+// button to another releases the first instead of holding it until lifted
+typedef struct
+{
+	int numTargets;
+	// In hundredths of a screen pixel, like touch input
+	GridRect bounds[MAX_TRACKER_TARGETS];
+	int flags[MAX_TRACKER_TARGETS];
+	// Rebuilt on the first hit test after targets change
+	bool indexed;
+	GridIndex index;
+	int cellStarts[MAX_TRACKER_CELLS + 1];
+	int cellItems[MAX_TRACKER_CELL_ITEMS];
+	int numContacts;
+	TrackedContact contacts[MAX_TRACKED_CONTACTS];
+	TrackerProc proc;
+	void* userData;
+	// Moves dropped because a later position of the same contact came in
+	// before they were applied
+	uint32_t coalescedMoves;
+	// Set by the caller when input arrives late
+	uint32_t staleBatches;
+} TouchTracker;
+
+void InitTracker(TouchTracker* tracker, TrackerProc proc, void* userData);
+// Return the index of the new target. Targets added later are on top of
+// earlier ones. An empty target is never hit.
+int AddTrackerTarget(
+	TouchTracker* tracker, int x, int y, int width, int height, int flags
+);
+// Follow a target moved by a display change
+void MoveTrackerTarget(
+	TouchTracker* tracker, int target, int x, int y, int width, int height
+);
+// Index of the topmost target containing a point or -1
+int HitTest(TouchTracker* tracker, int x, int y);
+void TrackContact(
+	TouchTracker* tracker, uint32_t id, TouchEvent event, int x, int y
+);
+// Keep only the latest position of a contact until ApplyDeferredMoves, for
+// input which queued up while the caller was busy. Downs and ups are never
+// deferred: an up applies the deferred move of the same contact first,
+// other events supersede it.
+void DeferMove(TouchTracker* tracker, uint32_t id, int x, int y);
+void ApplyDeferredMoves(TouchTracker* tracker);
+
+#endif
@@ -0,0 +1,93 @@
+#include <math.h>
+#include <string.h>
+#include "trackpad.h"
+
+void InitTrackpad(Trackpad* trackpad)
+{
+	memset(trackpad, 0, sizeof(Trackpad));
+	trackpad->sensitivity = 1.f;
+}
+
+void TrackpadDown(Trackpad* trackpad, int x, int y, Timestamp now)
+{
+	trackpad->active = true;
+	trackpad->lastX = x;
+	trackpad->lastY = y;
+	trackpad->lastTime = now;
+	trackpad->speed = 0.f;
+}
+
+void TrackpadMove(Trackpad* trackpad, Output* output, int x, int y, Timestamp now)
+{
+	if (!trackpad->active) { return; }
+
+	float dx = (float)(x - trackpad->lastX) / 100.f;
+	float dy = (float)(y - trackpad->lastY) / 100.f;
+	trackpad->lastX = x;
+	trackpad->lastY = y;
+
+	// Several moves can arrive with the same timestamp, keep the last speed
+	// for those
+	if (now > trackpad->lastTime)
+	{
+		float elapsedMs = (float)(now - trackpad->lastTime) / 1000.f;
+		trackpad->speed = sqrtf(dx * dx + dy * dy) / elapsedMs;
+		trackpad->lastTime = now;
+	}
+
+	float gain = trackpad->sensitivity
+		* (1.f + trackpad->acceleration * trackpad->speed);
+	float moveX = dx * gain + trackpad->remainderX;
+	float moveY = dy * gain + trackpad->remainderY;
+
+	// Only whole pixels can be injected, carry the rest to the next event
+	int wholeX = (int)moveX;
+	int wholeY = (int)moveY;
+	trackpad->remainderX = moveX - (float)wholeX;
+	trackpad->remainderY = moveY - (float)wholeY;
+
+	if (wholeX != 0 || wholeY != 0)
+	{
+		OutputMouseMove(output, wholeX, wholeY);
+	}
+}
+
+void TrackpadUp(Trackpad* trackpad)
+{
+	trackpad->active = false;
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(trackpad_subpixel)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Output output;
+	Trackpad trackpad;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitTrackpad(&trackpad);
+	trackpad.sensitivity = 0.5f;
+
+	// A slow drag of 0.3 pixel per event must still move the cursor
+	TrackpadDown(&trackpad, 0, 0, clock);
+	for (int i = 1; i <= 22; ++i)
+	{
+		clock += 1000;
+		TrackpadMove(&trackpad, &output, i * 30, -i * 30, clock);
+	}
+	TrackpadUp(&trackpad);
+
+	// All moves in one flush are coalesced into a single event
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(1, recorder.numEvents);
+	TEST_ASSERT_EQUAL_INT(OUTPUT_MOUSE_MOVE, recorder.events[0].event.type);
+	TEST_ASSERT_EQUAL_INT(3, recorder.events[0].event.data.move.dx);
+	TEST_ASSERT_EQUAL_INT(-3, recorder.events[0].event.data.move.dy);
+}
+
+#endif
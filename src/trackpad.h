@@ -0,0 +1,29 @@
+#ifndef TOUCH_JOY_TRACKPAD_H
+#define TOUCH_JOY_TRACKPAD_H
+
+#include <stdbool.h>
+#include "output.h"
+#include "scheduler.h"
+
+// Turns touch motion into relative mouse motion
+typedef struct
+{
+	float sensitivity;
+	// Extra gain per pixel/millisecond of finger speed
+	float acceleration;
+	bool active;
+	int lastX;
+	int lastY;
+	Timestamp lastTime;
+	float speed;
+	// Sub-pixel motion which has not been output yet
+	float remainderX;
+	float remainderY;
+} Trackpad;
+
+void InitTrackpad(Trackpad* trackpad);
+void TrackpadDown(Trackpad* trackpad, int x, int y, Timestamp now);
+void TrackpadMove(Trackpad* trackpad, Output* output, int x, int y, Timestamp now);
+void TrackpadUp(Trackpad* trackpad);
+
+#endif
@@ -0,0 +1,152 @@
+#include "typematic.h"
+
+static void ScheduleNextRepeat(Typematic* typematic)
+{
+	if (typematic->numKeys == 0)
+	{
+		CancelTimer(typematic->scheduler, &typematic->timer);
+		return;
+	}
+
+	Timestamp next = typematic->keys[0].next;
+	for (int i = 1; i < typematic->numKeys; ++i)
+	{
+		if (typematic->keys[i].next < next) { next = typematic->keys[i].next; }
+	}
+
+	ScheduleTimer(typematic->scheduler, &typematic->timer, next);
+}
+
+static void OnTypematicTimer(Timer* timer, Timestamp now)
+{
+	Typematic* typematic = (Typematic*)timer->userData;
+
+	for (int i = 0; i < typematic->numKeys; ++i)
+	{
+		RepeatingKey* key = &typematic->keys[i];
+		if (key->next > now) { continue; }
+
+		OutputKeyRepeat(typematic->output, key->code);
+
+		// Like a real keyboard, repeats missed during a stall are dropped
+		key->next += key->interval;
+		if (key->next <= now) { key->next = now + key->interval; }
+	}
+
+	ScheduleNextRepeat(typematic);
+}
+
+void InitTypematic(Typematic* typematic, Scheduler* scheduler, Output* output)
+{
+	InitTimer(&typematic->timer, &OnTypematicTimer, typematic);
+	typematic->scheduler = scheduler;
+	typematic->output = output;
+	typematic->numKeys = 0;
+}
+
+void StartRepeat(
+	Typematic* typematic,
+	const void* owner,
+	uint16_t code,
+	Timestamp delay,
+	Timestamp interval,
+	Timestamp now
+)
+{
+	StopRepeat(typematic, owner);
+	if (typematic->numKeys == MAX_REPEATING_KEYS) { return; }
+
+	RepeatingKey* key = &typematic->keys[typematic->numKeys++];
+	key->owner = owner;
+	key->code = code;
+	key->interval = interval;
+	key->next = now + delay;
+
+	ScheduleNextRepeat(typematic);
+}
+
+void StopRepeat(Typematic* typematic, const void* owner)
+{
+	for (int i = 0; i < typematic->numKeys; ++i)
+	{
+		if (typematic->keys[i].owner == owner)
+		{
+			typematic->keys[i] = typematic->keys[--typematic->numKeys];
+			ScheduleNextRepeat(typematic);
+			return;
+		}
+	}
+}
+
+void StopAllRepeats(Typematic* typematic)
+{
+	typematic->numKeys = 0;
+	if (typematic->scheduler) { ScheduleNextRepeat(typematic); }
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+static int CountPresses(const OutputRecorder* recorder, uint16_t code)
+{
+	int count = 0;
+	for (int i = 0; i < recorder->numEvents; ++i)
+	{
+		const OutputEvent* event = &recorder->events[i].event;
+		if (event->type == OUTPUT_KEY
+			&& event->data.key.code == code
+			&& event->data.key.down)
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+TEST(typematic_repeat)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Typematic typematic;
+	int owners[20];
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitTypematic(&typematic, &scheduler, &output);
+
+	// 20 held keys only need one timer
+	for (int i = 0; i < 20; ++i)
+	{
+		OutputKey(&output, (uint16_t)('A' + i), true);
+		StartRepeat(&typematic, &owners[i], (uint16_t)('A' + i), 500000, 40000, clock);
+	}
+	TEST_ASSERT_EQUAL_INT(1, scheduler.numTimers);
+
+	// 500ms delay then 25 repeats per second
+	Timestamp due;
+	while (GetNextDeadline(&scheduler, &due) && due <= 1000000)
+	{
+		clock = due;
+		RunScheduler(&scheduler, clock);
+	}
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(1 + 13, CountPresses(&recorder, 'A'));
+	TEST_ASSERT_EQUAL_INT(1 + 13, CountPresses(&recorder, 'T'));
+
+	// Nothing repeats after release
+	for (int i = 0; i < 20; ++i)
+	{
+		StopRepeat(&typematic, &owners[i]);
+		OutputKey(&output, (uint16_t)('A' + i), false);
+	}
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+	FlushOutput(&output);
+	TEST_ASSERT_EQUAL_INT(20 * 14 + 20, recorder.numEvents);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef TOUCH_JOY_TYPEMATIC_H
+#define TOUCH_JOY_TYPEMATIC_H
+
+#include <stdint.h>
+#include "output.h"
+#include "scheduler.h"
+
+#define MAX_REPEATING_KEYS 32
+
+typedef struct
+{
+	const void* owner;
+	uint16_t code;
+	Timestamp interval;
+	Timestamp next;
+} RepeatingKey;
+
+// Keyboard-like auto repeat for held keys.
+// All repeating keys share a single scheduler timer.
+typedef struct
+{
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	int numKeys;
+	RepeatingKey keys[MAX_REPEATING_KEYS];
+} Typematic;
+
+void InitTypematic(Typematic* typematic, Scheduler* scheduler, Output* output);
+// Repeat code every interval after an initial delay until StopRepeat is called
+// with the same owner
+void StartRepeat(
+	Typematic* typematic,
+	const void* owner,
+	uint16_t code,
+	Timestamp delay,
+	Timestamp interval,
+	Timestamp now
+);
+void StopRepeat(Typematic* typematic, const void* owner);
+void StopAllRepeats(Typematic* typematic);
+
+#endif
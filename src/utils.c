@@ -3,6 +3,7 @@
 #include <Windows.h>
 #include <varargs.h>
 #include <stdio.h>
+#include "utils.h"
 
 #define MAX_DEBUG_MSG 512
 
@@ -17,4 +18,32 @@ void DebugPrint(const char* format, ...)
 
 	OutputDebugString(buff);
 	OutputDebugString("\n");
-}
\ No newline at end of file
+}
+
+#ifdef _BENCHMARK
+void ReportBenchmark(const char* name, const char* format, ...)
+{
+	char buff[MAX_DEBUG_MSG];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buff, MAX_DEBUG_MSG, format, args);
+	va_end(args);
+
+	printf("%s: %s\r\n", name, buff);
+}
+#endif
+
+uint64_t GetTimestamp()
+{
+	static LARGE_INTEGER frequency;
+	if (frequency.QuadPart == 0) { QueryPerformanceFrequency(&frequency); }
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion to avoid overflowing on long uptimes
+	uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+	uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000 + remainder * 1000000 / frequency.QuadPart;
+}
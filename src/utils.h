@@ -1,10 +1,23 @@
 #ifndef TOUCH_JOY_UTILS_H
 #define TOUCH_JOY_UTILS_H
 
+#include <stdint.h>
+
 #define UNUSED(x) ((void)x)
 #define STR_EQUAL(lhs, rhs) (strcmp(lhs, rhs) == 0)
 #define TO_NUM(x) strtol(x, 0, 0)
+#define TO_BOOL(x) (STR_EQUAL(x, "true") || STR_EQUAL(x, "1"))
+// Expand a macro into a string literal
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
 
 void DebugPrint(const char* format, ...);
+// Monotonic time in microseconds
+uint64_t GetTimestamp();
+
+#ifdef _BENCHMARK
+// Print a benchmark's measurement, only benchmark builds are timed
+void ReportBenchmark(const char* name, const char* format, ...);
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <string.h>
+#include "wheel.h"
+
+// Same as WHEEL_DELTA
+#define WHEEL_UNITS_PER_NOTCH 120
+#define WHEEL_INTERVAL 10000
+#define MAX_WHEEL_SPEED 100.f
+
+static void OnWheelTimer(Timer* timer, Timestamp now)
+{
+	Wheel* wheel = (Wheel*)timer->userData;
+
+	float elapsed = (float)(now - wheel->lastTime) / 1000000.f;
+	float held = (float)(now - wheel->startTime) / 1000000.f;
+	wheel->lastTime = now;
+
+	float speed = wheel->speed + wheel->acceleration * held;
+	if (speed > MAX_WHEEL_SPEED) { speed = MAX_WHEEL_SPEED; }
+
+	// Output partial notches and carry what is left of a wheel unit
+	float delta = speed * WHEEL_UNITS_PER_NOTCH * elapsed * wheel->direction
+		+ wheel->remainder;
+	int wholeDelta = (int)delta;
+	wheel->remainder = delta - (float)wholeDelta;
+
+	if (wholeDelta != 0) { OutputWheel(wheel->output, wholeDelta); }
+
+	// Do not try to catch up after a stall
+	Timestamp next = timer->due + WHEEL_INTERVAL;
+	if (next <= now) { next = now + WHEEL_INTERVAL; }
+	ScheduleTimer(wheel->scheduler, timer, next);
+}
+
+void InitWheel(Wheel* wheel)
+{
+	memset(wheel, 0, sizeof(Wheel));
+	wheel->direction = 1;
+	wheel->amount = 1;
+	wheel->speed = 10.f;
+	wheel->acceleration = 20.f;
+	wheel->delay = 250;
+}
+
+void WheelDown(Wheel* wheel, Scheduler* scheduler, Output* output, Timestamp now)
+{
+	// Wheel events go to the window under the cursor
+	OutputMouseAbsolute(output, wheel->targetX, wheel->targetY);
+	OutputWheel(
+		output, WHEEL_UNITS_PER_NOTCH * wheel->direction * wheel->amount
+	);
+
+	if (wheel->speed <= 0.f) { return; }
+
+	// A second press, such as from the mouse, restarts the repeat
+	WheelUp(wheel);
+	InitTimer(&wheel->timer, &OnWheelTimer, wheel);
+	wheel->scheduler = scheduler;
+	wheel->output = output;
+	wheel->startTime = now + wheel->delay * 1000ull;
+	wheel->lastTime = wheel->startTime;
+	wheel->remainder = 0.f;
+	ScheduleTimer(scheduler, &wheel->timer, wheel->startTime);
+}
+
+void WheelUp(Wheel* wheel)
+{
+	if (wheel->scheduler) { CancelTimer(wheel->scheduler, &wheel->timer); }
+}
+
+#ifdef _TEST
+
+#include "utest.h"
+
+TEST(wheel_continuous)
+{
+	static OutputRecorder recorder;
+	Timestamp clock = 0;
+	Scheduler scheduler;
+	Output output;
+	Wheel wheel;
+
+	InitOutputRecorder(&recorder, &clock);
+	InitOutput(&output, &RecordOutput, &recorder);
+	InitScheduler(&scheduler);
+	InitWheel(&wheel);
+	wheel.direction = -1;
+	wheel.speed = 10.f;
+	wheel.acceleration = 0.f;
+	wheel.delay = 100;
+
+	WheelDown(&wheel, &scheduler, &output, clock);
+
+	// Hold for 100ms of delay plus one second of scrolling
+	Timestamp due;
+	while (GetNextDeadline(&scheduler, &due) && due <= 1100000)
+	{
+		clock = due;
+		RunScheduler(&scheduler, clock);
+	}
+	WheelUp(&wheel);
+	FlushOutput(&output);
+
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+	TEST_ASSERT_EQUAL_INT(OUTPUT_MOUSE_ABSOLUTE, recorder.events[0].event.type);
+	TEST_ASSERT_EQUAL_INT(-120, recorder.events[1].event.data.wheel.delta);
+
+	int total = 0;
+	for (int i = 2; i < recorder.numEvents; ++i)
+	{
+		int delta = recorder.events[i].event.data.wheel.delta;
+		// Continuous scrolling uses high resolution partial notches
+		TEST_ASSERT(delta < 0 && delta > -120);
+		total += delta;
+	}
+
+	TEST_ASSERT_EQUAL_DOUBLE(-1200.0, (double)total, 2.0);
+
+	// Pressing again while the repeat is pending leaves a single timer
+	WheelDown(&wheel, &scheduler, &output, clock);
+	WheelDown(&wheel, &scheduler, &output, clock);
+	TEST_ASSERT_EQUAL_INT(1, scheduler.numTimers);
+	WheelUp(&wheel);
+	TEST_ASSERT_EQUAL_INT(0, scheduler.numTimers);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef TOUCH_JOY_WHEEL_H
+#define TOUCH_JOY_WHEEL_H
+
+#include <stdbool.h>
+#include "output.h"
+#include "scheduler.h"
+
+// Scrolls once when pressed, then continuously while held
+typedef struct
+{
+	int direction;
+	// Notches scrolled on press
+	int amount;
+	// Notches per second while held, 0 disables continuous scrolling
+	float speed;
+	// Notches per second gained for every second held
+	float acceleration;
+	// Milliseconds before continuous scrolling starts
+	int delay;
+	// Where to put the cursor, in absolute mouse coordinates
+	int targetX;
+	int targetY;
+
+	Timer timer;
+	Scheduler* scheduler;
+	Output* output;
+	Timestamp startTime;
+	Timestamp lastTime;
+	// Fraction of a wheel unit which has not been output yet
+	float remainder;
+} Wheel;
+
+void InitWheel(Wheel* wheel);
+void WheelDown(Wheel* wheel, Scheduler* scheduler, Output* output, Timestamp now);
+void WheelUp(Wheel* wheel);
+
+#endif